@@ -0,0 +1,1109 @@
+#define ATS_IMPL
+#define ATS_OGL33
+#include "../ats/ats.h"
+#include "../ats/ats_platform.h"
+
+#define CUTE_C2_IMPLEMENTATION
+#include "../ats/ext/cute_c2.h"
+
+static u32 rs = 0xdeadbeef;
+
+#include "order.h"
+#include "map.h"
+#include "entity.h"
+#include "particle.h"
+#include "camera.h"
+#include "game_state.h"
+#include "entity_grid.h"
+
+#include "thread.h"
+#include "job.h"
+#include "profile.h"
+#include "input.h"
+#include "simd.h"
+
+#include "map_gen.h"
+
+#include "command.h"
+#include "path_finder.h"
+#include "path_service.h"
+#include "group.h"
+#include "visibility.h"
+#include "light.h"
+#include "minimap.h"
+#include "command_flush.h"
+#include "colony.h"
+#include "pheromone.h"
+#include "save.h"
+
+#if defined(_WIN32)
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+static memory_arena_t   ma              = {0};
+static game_state_t*    game_state      = NULL;
+static vec3_t           mouse_position  = { 0.5 * MAP_SIZE, 0.5 * MAP_SIZE };
+
+#include "init.c"
+#include "update.c"
+
+// Headless benchmark of the simulation.
+//
+//  bench [scenario...] [-ticks N] [-out file.json] [-compare baseline.json] [-threshold 0.1]
+//
+// Runs each scenario with a fixed time step and prints per phase timings as json. With -compare the mean time of
+// every phase is checked against the baseline file, and anything slower by more than the threshold is reported
+// as a regression (exit code 1). 'map_layout' (run by default) compares row major and blocked tile storage on a
+// flood fill, 'pheromone' (also run by default) times the diffusion kernel on a field four times the size of the
+// map, and 'map_gen' (same) times generating a 4096 x 4096 area on one thread and on the job system, with the scalar
+// and the best hash rows, and fails the run (exit code 1) if they don't all give the same tiles. Every second of
+// a run the incrementally updated minimap is checked against one built from scratch, and any pixel that differs fails
+// the run (exit code 1) as well. Scenarios that autosave also list every save with its main thread stall and the
+// time the save thread took to write it.
+
+#define BENCH_TICK_MAX  (4096)
+#define BENCH_DT        (1.0f / 60.0f)
+
+typedef struct bench_scenario_t {
+    const char* name;
+    u32         ticks;
+
+    void        (*init)(game_state_t* gs);
+    void        (*tick)(game_state_t* gs, u32 tick);
+} bench_scenario_t;
+
+typedef struct bench_stats_t {
+    f64 mean;
+    f64 p50;
+    f64 p95;
+    f64 p99;
+    f64 max;
+} bench_stats_t;
+
+// one column per phase, plus the whole tick:
+static f64 bench_sample[PROFILE_COUNT + 1][BENCH_TICK_MAX];
+
+static vec2_t bench_random_open_position(game_state_t* gs) {
+    while (true) {
+        vec2i_t pos = { rand_i32(&rs, 0, MAP_SIZE - 1), rand_i32(&rs, 0, MAP_SIZE - 1) };
+
+        if (map_is_traversable(&gs->map, pos.x, pos.y)) {
+            return v2(pos.x + 0.5, pos.y + 0.5);
+        }
+    }
+}
+
+static void bench_clear_area(game_state_t* gs, i32 min_x, i32 min_y, i32 max_x, i32 max_y) {
+    for (i32 y = min_y; y <= max_y; ++y) {
+        for (i32 x = min_x; x <= max_x; ++x) {
+            map_set_tile(&gs->map, x, y, TILE_TYPE_DIRT);
+        }
+    }
+
+    map_clear_changes(&gs->map);
+}
+
+static void bench_spawn(game_state_t* gs, entity_type_t type, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        add_entity(gs, &(entity_desc_t) {
+            .type   = type,
+            .pos    = bench_random_open_position(gs),
+        });
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// scenarios:
+
+// everyone crammed into one open room and pulled towards its middle:
+static void bench_crowd_init(game_state_t* gs) {
+    gs->entity_count = 0;
+
+    bench_clear_area(gs, 96, 96, 160, 160);
+
+    for (u32 i = 0; i < ENTITY_MAX; ++i) {
+        entity_t* e = add_entity(gs, &(entity_desc_t) {
+            .type   = ENTITY_TYPE_ANT,
+            .pos    = v2(rand_f32(&rs, 97, 159), rand_f32(&rs, 97, 159)),
+        });
+
+        e->target_pos = v2(0.5 * MAP_SIZE + rand_f32(&rs, -4, 4), 0.5 * MAP_SIZE + rand_f32(&rs, -4, 4));
+        entity_set_ai(e, AI_ANT_AGRO);
+    }
+}
+
+static void bench_path_storm_init(game_state_t* gs) {
+    gs->entity_count = 0;
+
+    bench_spawn(gs, ENTITY_TYPE_GUARD, 64);
+    bench_spawn(gs, ENTITY_TYPE_ANT, 1024);
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        if (e->type == ENTITY_TYPE_ANT) {
+            entity_set_ai(e, AI_ANT_AGRO);
+        }
+    }
+}
+
+// every so often the ants pick a new spot on the other side of the map:
+static void bench_path_storm_tick(game_state_t* gs, u32 tick) {
+    if (tick % 60 != 0) return;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        if (e->type == ENTITY_TYPE_ANT) {
+            e->target_pos = bench_random_open_position(gs);
+        }
+    }
+}
+
+static void bench_dig_orders_init(game_state_t* gs) {
+    gs->entity_count = 0;
+
+    bench_spawn(gs, ENTITY_TYPE_WORKER, 256);
+
+    for_map(x, y) {
+        tile_t* tile = map_get_tile(&gs->map, x, y);
+
+        if (tile_get_info(tile)->is_wall && (x + y) % 3 == 0) {
+            tile->order = ORDER_TYPE_DESTROY_TILE;
+        }
+    }
+}
+
+static void bench_particles_init(game_state_t* gs) {
+    gs->entity_count = 0;
+}
+
+static void bench_particles_tick(game_state_t* gs, u32 tick) {
+    add_particle(gs, &(particle_desc_t) {
+        .count          = 512,
+        .pos            = v3(0.5 * MAP_SIZE, 0.5 * MAP_SIZE, 1),
+        .vel            = v3(0, 0, 1),
+        .rad            = 0.05,
+        .life           = 2,
+        .turbulance     = 4,
+        .start_color    = v4(1, 0.8, 0.4, 1),
+        .end_color      = v4(0.2, 0.2, 0.2, 0),
+        .rand = {
+            .pos        = 0.5,
+            .vel        = 2,
+        },
+    });
+}
+
+// units spread over the whole map, with a band of orders sweeping across it:
+static void bench_map_sweep_init(game_state_t* gs) {
+    gs->entity_count = 0;
+
+    bench_spawn(gs, ENTITY_TYPE_WORKER, 128);
+    bench_spawn(gs, ENTITY_TYPE_GUARD, 16);
+    bench_spawn(gs, ENTITY_TYPE_ANT, 1024);
+}
+
+static void bench_map_sweep_tick(game_state_t* gs, u32 tick) {
+    i32 column = (tick * 2) % MAP_SIZE;
+
+    for (i32 y = 0; y < MAP_SIZE; ++y) {
+        map_get_tile(&gs->map, column, y)->order = ORDER_TYPE_DESTROY_TILE;
+    }
+}
+
+// the map sweep with an autosave every few ticks, the 'save' phase is the main thread stall:
+static void bench_autosave_init(game_state_t* gs) {
+    bench_map_sweep_init(gs);
+    save_interval = 0.25f;
+}
+
+// four squads of guards, each sent across the map as one group every few seconds:
+static void bench_group_move_init(game_state_t* gs) {
+    gs->entity_count = 0;
+
+    bench_clear_area(gs, 96, 96, 160, 160);
+
+    for (u32 i = 0; i < 256; ++i) {
+        add_entity(gs, &(entity_desc_t) {
+            .type   = ENTITY_TYPE_GUARD,
+            .pos    = v2(rand_f32(&rs, 97, 159), rand_f32(&rs, 97, 159)),
+        });
+    }
+}
+
+static void bench_group_move_tick(game_state_t* gs, u32 tick) {
+    if (tick % 150 != 0) return;
+
+    for (u32 squad = 0; squad < 4; ++squad) {
+        for (u32 i = 0; i < gs->entity_count; ++i) {
+            entity_t* e = &gs->entity_array[i];
+            e->selected = e->id % 4 == squad;
+        }
+
+        group_order_move(gs, command_buffer_get(0), bench_random_open_position(gs));
+    }
+}
+
+// tens of thousands of ants all over the map, a few workers in the middle and the camera circling far around them, so
+// ants keep getting folded and materialized along the way:
+static void bench_colony_init(game_state_t* gs) {
+    gs->entity_count = 0;
+
+    // inside a single colony chunk:
+    bench_clear_area(gs, 98, 98, 110, 110);
+
+    for (u32 i = 0; i < 24; ++i) {
+        add_entity(gs, &(entity_desc_t) {
+            .type   = ENTITY_TYPE_WORKER,
+            .pos    = v2(rand_f32(&rs, 99, 109), rand_f32(&rs, 99, 109)),
+        });
+    }
+
+    for (u32 i = 0; i < 16 * 1024; ++i) {
+        colony_chunk_array[colony_chunk_index(bench_random_open_position(gs))].count++;
+    }
+}
+
+static void bench_colony_tick(game_state_t* gs, u32 tick) {
+    f32 angle = 2 * PI * tick / 600.0f;
+
+    gs->cam.pos.x = 104 + 96 * cosf(angle);
+    gs->cam.pos.y = 104 + 96 * sinf(angle);
+}
+
+// a few agro ants running around a map full of idle ones, so the alarm keeps spreading and idle ants keep picking
+// up the trail and losing it again. The workers keep the ants around them from being folded:
+static void bench_alarm_init(game_state_t* gs) {
+    gs->entity_count = 0;
+
+    bench_spawn(gs, ENTITY_TYPE_WORKER, 64);
+    bench_spawn(gs, ENTITY_TYPE_ANT, ENTITY_MAX - 128);
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        if (e->type == ENTITY_TYPE_ANT && i % 16 == 0) {
+            e->target_pos = bench_random_open_position(gs);
+            entity_set_ai(e, AI_ANT_AGRO);
+        }
+    }
+}
+
+static void bench_alarm_tick(game_state_t* gs, u32 tick) {
+    if (tick % 120 != 0) return;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        if (e->ai == AI_ANT_AGRO) {
+            e->target_pos = bench_random_open_position(gs);
+        }
+    }
+}
+
+static bench_scenario_t bench_scenario_array[] = {
+    { "crowd",          600,    bench_crowd_init,       NULL                    },
+    { "path_storm",     600,    bench_path_storm_init,  bench_path_storm_tick   },
+    { "dig_orders",     600,    bench_dig_orders_init,  NULL                    },
+    { "particles",      600,    bench_particles_init,   bench_particles_tick    },
+    { "map_sweep",      600,    bench_map_sweep_init,   bench_map_sweep_tick    },
+    { "autosave",       600,    bench_autosave_init,    bench_map_sweep_tick    },
+    { "group_move",     600,    bench_group_move_init,  bench_group_move_tick   },
+    { "colony",         600,    bench_colony_init,      bench_colony_tick       },
+    { "alarm",          600,    bench_alarm_init,       bench_alarm_tick        },
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------
+
+static int bench_compare_f64(const void* a, const void* b) {
+    f64 x = *(const f64*)a;
+    f64 y = *(const f64*)b;
+
+    return (x > y) - (x < y);
+}
+
+static bench_stats_t bench_get_stats(f64* samples, u32 count) {
+    bench_stats_t stats = {0};
+    if (count == 0) return stats;
+
+    for (u32 i = 0; i < count; ++i) {
+        stats.mean += samples[i];
+    }
+
+    qsort(samples, count, sizeof (f64), bench_compare_f64);
+
+    stats.mean /= count;
+    stats.p50   = samples[(count - 1) * 50 / 100];
+    stats.p95   = samples[(count - 1) * 95 / 100];
+    stats.p99   = samples[(count - 1) * 99 / 100];
+    stats.max   = samples[count - 1];
+
+    return stats;
+}
+
+static u64 bench_peak_memory_kb(void) {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters = {0};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof (counters));
+
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage = {0};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+#endif
+}
+
+static void bench_print_stats(FILE* out, const char* name, bench_stats_t stats, b32 last) {
+    fprintf(out, "        \"%s\": { \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p95_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f }%s\n",
+            name, 1000 * stats.mean, 1000 * stats.p50, 1000 * stats.p95, 1000 * stats.p99, 1000 * stats.max, last? "" : ",");
+}
+
+static u32 bench_minimap_mismatches;
+static u32 bench_ant_drift;
+
+// every save a run made, as they finished:
+static save_stats_t bench_save_array[BENCH_TICK_MAX];
+static u32          bench_save_count;
+static u32          bench_save_read;
+
+static void bench_collect_saves(void) {
+    u32 count = atomic_load_u32(&save_stats_count);
+
+    for (; bench_save_read < count; ++bench_save_read) {
+        if (bench_save_count < ARRAY_COUNT(bench_save_array)) {
+            bench_save_array[bench_save_count++] = save_stats_array[bench_save_read % SAVE_STATS_MAX];
+        }
+    }
+}
+
+// guards are the only thing that removes ants, nothing adds them:
+static b32 bench_has_guards(const game_state_t* gs) {
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        if (gs->entity_array[i].type == ENTITY_TYPE_GUARD) return true;
+    }
+
+    return false;
+}
+
+// how many pixels of the minimap differ from a full rebuild:
+static u32 bench_minimap_check(const game_state_t* gs) {
+    static u32              pixels[MINIMAP_SIZE * MINIMAP_SIZE];
+    static minimap_dot_t    dots[MINIMAP_CELL_COUNT];
+
+    minimap_build(pixels, dots, gs);
+
+    u32 count = 0;
+
+    for (u32 i = 0; i < MINIMAP_SIZE * MINIMAP_SIZE; ++i) {
+        count += pixels[i] != minimap_pixels[i];
+    }
+
+    return count;
+}
+
+static void bench_run(FILE* out, const bench_scenario_t* scenario, u32 ticks, bench_stats_t* result, b32 last) {
+    game_state_t* gs = game_state;
+
+    rs = 0xdeadbeef;
+
+    save_interval   = SAVE_INTERVAL;
+    save_timer      = 0;
+
+    bench_save_count    = 0;
+    bench_save_read     = save_stats_count;
+
+    path_service_init();
+    group_init();
+    vis_init();
+    light_init();
+    minimap_init();
+    colony_init();
+    pheromone_init();
+    init_game(gs);
+    scenario->init(gs);
+
+    ticks = MIN(ticks, BENCH_TICK_MAX);
+
+    u32 peak_entities   = 0;
+    u32 peak_particles  = 0;
+    u64 expansions      = path_service_expansion_count();
+    u32 mismatches      = 0;
+    u32 drift           = 0;
+    b32 guards          = bench_has_guards(gs);
+
+    for (u32 tick = 0; tick < ticks; ++tick) {
+        if (scenario->tick) scenario->tick(gs, tick);
+
+        // folded ants plus ant entities, has to survive folding, flow and materializing:
+        u32 ants = colony_ant_count(gs);
+
+        profile_reset();
+
+        f64 start = profile_time();
+        update_game(gs, BENCH_DT);
+        f64 total = profile_time() - start;
+
+        for (u32 i = 0; i < PROFILE_COUNT; ++i) {
+            bench_sample[i][tick] = profile_phase_time[i];
+        }
+
+        bench_sample[PROFILE_COUNT][tick] = total;
+
+        peak_entities   = MAX(peak_entities, gs->entity_count);
+        peak_particles  = MAX(peak_particles, gs->particle_count);
+
+        u32 ants_after = colony_ant_count(gs);
+
+        if (guards? ants_after > ants : ants_after != ants) {
+            drift++;
+        }
+
+        if (tick % 60 == 59) {
+            mismatches += bench_minimap_check(gs);
+        }
+
+        bench_collect_saves();
+    }
+
+    bench_minimap_mismatches += mismatches;
+    bench_ant_drift          += drift;
+
+    save_wait();
+    bench_collect_saves();
+    path_service_init();
+
+    expansions = path_service_expansion_count() - expansions;
+
+    for (u32 i = 0; i <= PROFILE_COUNT; ++i) {
+        result[i] = bench_get_stats(bench_sample[i], ticks);
+    }
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", scenario->name);
+    fprintf(out, "      \"ticks\": %u,\n", ticks);
+    fprintf(out, "      \"peak_entities\": %u,\n", peak_entities);
+    fprintf(out, "      \"peak_particles\": %u,\n", peak_particles);
+    fprintf(out, "      \"peak_memory_kb\": %llu,\n", (unsigned long long)bench_peak_memory_kb());
+    fprintf(out, "      \"path_expansions\": %llu,\n", (unsigned long long)expansions);
+    fprintf(out, "      \"minimap_mismatches\": %u,\n", mismatches);
+    fprintf(out, "      \"ant_drift\": %u,\n", drift);
+    fprintf(out, "      \"phases\": {\n");
+
+    for (u32 i = 0; i < PROFILE_COUNT; ++i) {
+        bench_print_stats(out, profile_phase_name[i], result[i], false);
+    }
+
+    bench_print_stats(out, "total", result[PROFILE_COUNT], true);
+
+    fprintf(out, "      }%s\n", bench_save_count? "," : "");
+
+    // the 'save' phase above is spread over every tick, this is what each save actually cost:
+    if (bench_save_count) {
+        fprintf(out, "      \"saves\": [\n");
+
+        for (u32 i = 0; i < bench_save_count; ++i) {
+            const save_stats_t* save = &bench_save_array[i];
+
+            fprintf(out, "        { \"full\": %s, \"chunks\": %u, \"size_kb\": %.1f, \"stall_ms\": %.4f, \"write_ms\": %.3f }%s\n",
+                    save->full? "true" : "false", save->chunk_count, save->size / 1024.0, 1000 * save->stall,
+                    1000 * save->write_time, i + 1 < bench_save_count? "," : "");
+        }
+
+        fprintf(out, "      ]\n");
+    }
+    fprintf(out, "    }%s\n", last? "" : ",");
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// map layout: the same flood fill over the same map with row major and with blocked tile storage, timed,
+// and replayed through a simulated 32 KB 8-way L1 to count misses on the tile and visited arrays.
+
+#define BENCH_CACHE_LINE    (64)
+#define BENCH_CACHE_SETS    (64)
+#define BENCH_CACHE_WAYS    (8)
+#define BENCH_LAYOUT_RUNS   (32)
+#define BENCH_LAYOUT_SHIFT  (2)
+
+typedef u32 bench_layout_t;
+enum {
+    BENCH_LAYOUT_ROW_MAJOR,
+    BENCH_LAYOUT_BLOCKED,
+    //
+    BENCH_LAYOUT_COUNT,
+};
+
+static const char* bench_layout_name[BENCH_LAYOUT_COUNT] = {
+    [BENCH_LAYOUT_ROW_MAJOR]    = "row_major",
+    [BENCH_LAYOUT_BLOCKED]      = "blocked",
+};
+
+typedef struct bench_cache_t {
+    // most recently used first:
+    u64     line[BENCH_CACHE_SETS][BENCH_CACHE_WAYS];
+
+    u64     access_count;
+    u64     miss_count;
+} bench_cache_t;
+
+static tile_t   bench_layout_tiles[BENCH_LAYOUT_COUNT][MAP_SIZE * MAP_SIZE];
+static u32      bench_layout_visited[MAP_SIZE * MAP_SIZE];
+static vec2i_t  bench_layout_queue[MAP_SIZE * MAP_SIZE];
+
+static void bench_cache_access(bench_cache_t* cache, const void* address) {
+    u64 line    = (u64)(uintptr_t)address / BENCH_CACHE_LINE + 1;
+    u64* set    = cache->line[line % BENCH_CACHE_SETS];
+    u32 way     = 0;
+
+    cache->access_count++;
+
+    while (way < BENCH_CACHE_WAYS - 1 && set[way] != line) way++;
+
+    if (set[way] != line) {
+        cache->miss_count++;
+    }
+
+    memmove(set + 1, set, way * sizeof (u64));
+    set[0] = line;
+}
+
+static u32 bench_layout_index(bench_layout_t layout, i32 x, i32 y) {
+    return map_index_blocked(x, y, layout == BENCH_LAYOUT_BLOCKED? BENCH_LAYOUT_SHIFT : 0);
+}
+
+// returns the number of tiles reached, 'cache' may be NULL:
+static u32 bench_layout_bfs(bench_layout_t layout, vec2i_t start, u32 id, bench_cache_t* cache) {
+    const tile_t*   tiles   = bench_layout_tiles[layout];
+    u32             begin   = 0;
+    u32             end     = 0;
+
+    bench_layout_queue[end++] = start;
+    bench_layout_visited[bench_layout_index(layout, start.x, start.y)] = id;
+
+    while (begin < end) {
+        vec2i_t pos = bench_layout_queue[begin++];
+
+        for (u32 i = 0; i < ARRAY_COUNT(path_dirs); ++i) {
+            vec2i_t next = v2i_add(pos, path_dirs[i]);
+            if (OFF_MAP(next.x, next.y)) continue;
+
+            u32 index = bench_layout_index(layout, next.x, next.y);
+
+            if (cache) bench_cache_access(cache, &bench_layout_visited[index]);
+            if (bench_layout_visited[index] == id) continue;
+
+            if (cache) bench_cache_access(cache, &tiles[index]);
+            if (!tile_is_traversable(&tiles[index])) continue;
+
+            bench_layout_visited[index] = id;
+            bench_layout_queue[end++]   = next;
+        }
+    }
+
+    return end;
+}
+
+static void bench_map_layout(FILE* out, b32 last) {
+    game_state_t* gs = game_state;
+
+    rs = 0xdeadbeef;
+    init_game(gs);
+
+    // open everything but the ore, so a flood covers most of the map:
+    for_map(x, y) {
+        tile_t tile = *map_get_tile(&gs->map, x, y);
+
+        if (tile.type == TILE_TYPE_ROCK) {
+            init_tile(&tile, TILE_TYPE_DIRT);
+        }
+
+        for (u32 layout = 0; layout < BENCH_LAYOUT_COUNT; ++layout) {
+            bench_layout_tiles[layout][bench_layout_index(layout, x, y)] = tile;
+        }
+    }
+
+    vec2i_t start_array[BENCH_LAYOUT_RUNS];
+
+    for (u32 i = 0; i < BENCH_LAYOUT_RUNS; ++i) {
+        start_array[i] = v2_cast(vec2i_t, bench_random_open_position(gs));
+    }
+
+    static bench_cache_t cache;
+    u32 id = 0;
+
+    fprintf(out, "  \"map_layout\": {\n");
+    fprintf(out, "    \"block\": %u,\n", 1 << BENCH_LAYOUT_SHIFT);
+
+    for (u32 layout = 0; layout < BENCH_LAYOUT_COUNT; ++layout) {
+        memset(bench_layout_visited, 0, sizeof (bench_layout_visited));
+
+        // warm up, so the first layout doesn't pay for the cold caches:
+        bench_layout_bfs(layout, start_array[0], ++id, NULL);
+
+        u64 tile_count  = 0;
+        f64 start       = profile_time();
+
+        for (u32 i = 0; i < BENCH_LAYOUT_RUNS; ++i) {
+            tile_count += bench_layout_bfs(layout, start_array[i], ++id, NULL);
+        }
+
+        f64 time = profile_time() - start;
+
+        memset(&cache, 0, sizeof (cache));
+        bench_layout_bfs(layout, start_array[0], ++id, &cache);
+
+        fprintf(out, "    \"%s\": { \"bfs_ms\": %.4f, \"mtiles_per_s\": %.2f, \"cache_accesses\": %llu, \"cache_misses\": %llu, \"miss_rate\": %.4f }%s\n",
+                bench_layout_name[layout], 1000 * time / BENCH_LAYOUT_RUNS, tile_count / time * 1e-6,
+                (unsigned long long)cache.access_count, (unsigned long long)cache.miss_count,
+                (f64)cache.miss_count / cache.access_count, layout + 1 < BENCH_LAYOUT_COUNT? "," : "");
+    }
+
+    fprintf(out, "  }%s\n", last? "" : ",");
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// pheromone: diffusion steps on a field four times the map in each direction (the map tiled), with the scalar and the
+// AVX2 row, on one thread and spread over the job system. Both rows are meant to give the same result to the bit,
+// 'max_difference' is how far apart they ended up. Then a long run on a field the size of the map, starting full
+// everywhere, for long enough that decay alone would take all of it into denormals. Any denormal left at the end fails the
+// run (exit code 1), since a field full of them makes a step many times slower.
+
+#define BENCH_PHEROMONE_SIZE    (4 * MAP_SIZE)
+#define BENCH_PHEROMONE_STEPS   (64)
+#define BENCH_PHEROMONE_LONG    (16384)
+#define BENCH_PHEROMONE_WINDOW  (256)
+
+typedef struct bench_pheromone_run_t {
+    const char*         name;
+    pheromone_row_t*    row;
+    b32                 jobs;
+} bench_pheromone_run_t;
+
+static u8  bench_pheromone_links[BENCH_PHEROMONE_SIZE * BENCH_PHEROMONE_SIZE];
+static f32 bench_pheromone_start[BENCH_PHEROMONE_SIZE * BENCH_PHEROMONE_SIZE];
+static f32 bench_pheromone_value[2][BENCH_PHEROMONE_SIZE * BENCH_PHEROMONE_SIZE];
+static f32 bench_pheromone_scalar[BENCH_PHEROMONE_SIZE * BENCH_PHEROMONE_SIZE];
+
+static i32 bench_pheromone_size;
+static u32 bench_pheromone_denormals;
+
+static b32 bench_pheromone_open(i32 x, i32 y) {
+    if (x < 0 || y < 0 || x >= bench_pheromone_size || y >= bench_pheromone_size) return false;
+    return map_is_traversable(&game_state->map, x % MAP_SIZE, y % MAP_SIZE);
+}
+
+// the result is in 'bench_pheromone_value[0]', returns seconds per step:
+static f64 bench_pheromone_steps(const pheromone_grid_t* grid, f32 decay, const bench_pheromone_run_t* run) {
+    memcpy(bench_pheromone_value[0], bench_pheromone_start, sizeof (bench_pheromone_start));
+
+    f64 start = profile_time();
+
+    for (u32 step = 0; step < BENCH_PHEROMONE_STEPS; ++step) {
+        const f32*  in  = bench_pheromone_value[step & 1];
+        f32*        out = bench_pheromone_value[!(step & 1)];
+
+        if (run->jobs) {
+            pheromone_step(grid, in, out, decay, run->row);
+        } else {
+            for (u32 y = 0; y < grid->height; ++y) {
+                run->row(grid, in, out, y, decay);
+            }
+        }
+    }
+
+    return (profile_time() - start) / BENCH_PHEROMONE_STEPS;
+}
+
+static void bench_pheromone(FILE* out, b32 last) {
+    game_state_t* gs = game_state;
+
+    rs = 0xdeadbeef;
+    init_game(gs);
+
+    pheromone_grid_t grid = { BENCH_PHEROMONE_SIZE, BENCH_PHEROMONE_SIZE, bench_pheromone_links };
+
+    bench_pheromone_size = BENCH_PHEROMONE_SIZE;
+
+    for (i32 y = 0; y < BENCH_PHEROMONE_SIZE; ++y) {
+        for (i32 x = 0; x < BENCH_PHEROMONE_SIZE; ++x) {
+            pheromone_grid_set(&grid, bench_pheromone_open, x, y);
+        }
+    }
+
+    memset(bench_pheromone_start, 0, sizeof (bench_pheromone_start));
+
+    for (u32 i = 0; i < 1024; ++i) {
+        vec2_t pos = bench_random_open_position(gs);
+
+        pos.x += MAP_SIZE * rand_i32(&rs, 0, 3);
+        pos.y += MAP_SIZE * rand_i32(&rs, 0, 3);
+
+        bench_pheromone_start[(u32)pos.y * BENCH_PHEROMONE_SIZE + (u32)pos.x] = PHEROMONE_MAX;
+    }
+
+    f32                     decay   = powf(0.5f, PHEROMONE_STEP_TIME / PHEROMONE_HALF_LIFE);
+    pheromone_row_t*        best    = pheromone_best_row();
+    bench_pheromone_run_t   run_array[] = {
+        { "scalar",         pheromone_row_scalar,   false   },
+        { "scalar_jobs",    pheromone_row_scalar,   true    },
+        { "best",           best,                   false   },
+        { "best_jobs",      best,                   true    },
+    };
+
+    f32 max_difference = 0;
+
+    fprintf(out, "  \"pheromone\": {\n");
+    fprintf(out, "    \"size\": %u,\n", BENCH_PHEROMONE_SIZE);
+    fprintf(out, "    \"avx2\": %s,\n", best != pheromone_row_scalar? "true" : "false");
+
+    for (u32 i = 0; i < ARRAY_COUNT(run_array); ++i) {
+        // warm up, so the first run doesn't pay for the cold caches:
+        bench_pheromone_steps(&grid, decay, &run_array[i]);
+
+        f64 time = bench_pheromone_steps(&grid, decay, &run_array[i]);
+
+        if (i == 0) {
+            memcpy(bench_pheromone_scalar, bench_pheromone_value[0], sizeof (bench_pheromone_scalar));
+        } else {
+            for (u32 j = 0; j < BENCH_PHEROMONE_SIZE * BENCH_PHEROMONE_SIZE; ++j) {
+                max_difference = MAX(max_difference, fabsf(bench_pheromone_value[0][j] - bench_pheromone_scalar[j]));
+            }
+        }
+
+        fprintf(out, "    \"%s\": { \"step_ms\": %.4f, \"mtiles_per_s\": %.2f },\n",
+                run_array[i].name, 1000 * time, (f64)BENCH_PHEROMONE_SIZE * BENCH_PHEROMONE_SIZE / time * 1e-6);
+    }
+
+    fprintf(out, "    \"max_difference\": %g,\n", max_difference);
+
+    // the long run, stepped the way the game does it:
+    pheromone_grid_t small = { MAP_SIZE, MAP_SIZE, bench_pheromone_links };
+
+    bench_pheromone_size = MAP_SIZE;
+
+    for (i32 y = 0; y < MAP_SIZE; ++y) {
+        for (i32 x = 0; x < MAP_SIZE; ++x) {
+            pheromone_grid_set(&small, bench_pheromone_open, x, y);
+        }
+    }
+
+    memset(bench_pheromone_value, 0, sizeof (bench_pheromone_value));
+
+    for (u32 i = 0; i < MAP_SIZE * MAP_SIZE; ++i) {
+        if (bench_pheromone_links[i] != PHEROMONE_WALL) bench_pheromone_value[0][i] = PHEROMONE_MAX;
+    }
+
+    f64 first   = 0;
+    f64 start   = profile_time();
+
+    for (u32 step = 0; step < BENCH_PHEROMONE_LONG; ++step) {
+        if (step == BENCH_PHEROMONE_WINDOW) {
+            first = profile_time() - start;
+        }
+
+        if (step == BENCH_PHEROMONE_LONG - BENCH_PHEROMONE_WINDOW) {
+            start = profile_time();
+        }
+
+        pheromone_step(&small, bench_pheromone_value[step & 1], bench_pheromone_value[!(step & 1)], decay, best);
+    }
+
+    f64 final   = profile_time() - start;
+    u32 count   = 0;
+
+    for (u32 i = 0; i < MAP_SIZE * MAP_SIZE; ++i) {
+        count += fpclassify(bench_pheromone_value[0][i]) == FP_SUBNORMAL;
+    }
+
+    bench_pheromone_denormals += count;
+
+    fprintf(out, "    \"long_run\": { \"steps\": %u, \"first_step_ms\": %.4f, \"last_step_ms\": %.4f, \"denormals\": %u }\n",
+            BENCH_PHEROMONE_LONG, 1000 * first / BENCH_PHEROMONE_WINDOW, 1000 * final / BENCH_PHEROMONE_WINDOW, count);
+    fprintf(out, "  }%s\n", last? "" : ",");
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// map_gen: a BENCH_MAP_GEN_SIZE square area generated chunk by chunk on this thread, then spread over the job system,
+// once with the scalar hash rows and once with the best ones the cpu has. Every tile only depends on (seed, x, y), so
+// all runs have to come out the same to the bit ('identical'), or the run fails.
+
+#define BENCH_MAP_GEN_SIZE (4096)
+
+typedef struct bench_map_gen_run_t {
+    const char*             name;
+    const map_gen_rows_t*   rows;
+    b32                     jobs;
+} bench_map_gen_run_t;
+
+static tile_type_t bench_map_gen_tiles[BENCH_MAP_GEN_SIZE * BENCH_MAP_GEN_SIZE];
+static b32         bench_map_gen_differs;
+
+static u64 bench_map_gen_hash(void) {
+    u64 hash = 0xcbf29ce484222325ull;
+
+    for (u32 i = 0; i < BENCH_MAP_GEN_SIZE * BENCH_MAP_GEN_SIZE; ++i) {
+        hash = (hash ^ bench_map_gen_tiles[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static void bench_map_gen(FILE* out, b32 last) {
+    const map_gen_rows_t*   best        = map_gen_best_rows();
+    bench_map_gen_run_t     run_array[] = {
+        { "scalar",         &map_gen_rows_scalar,   false   },
+        { "scalar_jobs",    &map_gen_rows_scalar,   true    },
+        { "best",           best,                   false   },
+        { "best_jobs",      best,                   true    },
+    };
+
+    u64 first_hash  = 0;
+    b32 identical   = true;
+
+    fprintf(out, "  \"map_gen\": {\n");
+    fprintf(out, "    \"size\": %u,\n", BENCH_MAP_GEN_SIZE);
+    fprintf(out, "    \"avx2\": %s,\n", best != &map_gen_rows_scalar? "true" : "false");
+
+    for (u32 i = 0; i < ARRAY_COUNT(run_array); ++i) {
+        map_gen_desc_t desc = {
+            .seed           = 0xdeadbeef,
+            .rows           = run_array[i].rows,
+            .spawn          = v2(0.5 * BENCH_MAP_GEN_SIZE, 0.5 * BENCH_MAP_GEN_SIZE),
+            .spawn_radius   = 3,
+        };
+
+        map_gen_area_t area = {
+            .desc           = &desc,
+            .width          = BENCH_MAP_GEN_SIZE,
+            .height         = BENCH_MAP_GEN_SIZE,
+            .chunk_count_x  = BENCH_MAP_GEN_SIZE / MAP_GEN_CHUNK,
+            .tiles          = bench_map_gen_tiles,
+        };
+
+        u32 chunk_count = area.chunk_count_x * (BENCH_MAP_GEN_SIZE / MAP_GEN_CHUNK);
+
+        // so no run gets the tiles of the one before for free:
+        memset(bench_map_gen_tiles, 0, sizeof (bench_map_gen_tiles));
+
+        f64 start = profile_time();
+
+        if (run_array[i].jobs) {
+            map_gen_area(&desc, BENCH_MAP_GEN_SIZE, BENCH_MAP_GEN_SIZE, bench_map_gen_tiles);
+        } else {
+            for (u32 j = 0; j < chunk_count; ++j) {
+                map_gen_area_job(&area, j, 0);
+            }
+        }
+
+        f64 time = profile_time() - start;
+        u64 hash = bench_map_gen_hash();
+
+        if (i == 0) first_hash = hash;
+
+        identical &= hash == first_hash;
+
+        fprintf(out, "    \"%s\": { \"ms\": %.2f, \"mtiles_per_s\": %.2f },\n",
+                run_array[i].name, 1000 * time, (f64)BENCH_MAP_GEN_SIZE * BENCH_MAP_GEN_SIZE / time * 1e-6);
+    }
+
+    bench_map_gen_differs |= !identical;
+
+    fprintf(out, "    \"hash\": \"%016llx\",\n", (unsigned long long)first_hash);
+    fprintf(out, "    \"identical\": %s\n", identical? "true" : "false");
+    fprintf(out, "  }%s\n", last? "" : ",");
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// baseline comparison, only understands files written by this program:
+
+static char* bench_read_file(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* text = calloc(size + 1, 1);
+    fread(text, 1, size, file);
+    fclose(file);
+
+    return text;
+}
+
+static b32 bench_find_baseline(const char* json, const char* scenario, const char* phase, f64* mean) {
+    char key[128];
+
+    snprintf(key, sizeof (key), "\"name\": \"%s\"", scenario);
+    const char* it = strstr(json, key);
+    if (!it) return false;
+
+    const char* end = strstr(it + 1, "\"name\":");
+
+    snprintf(key, sizeof (key), "\"%s\": {", phase);
+    it = strstr(it, key);
+    if (!it || (end && it > end)) return false;
+
+    it = strstr(it, "\"mean_ms\":");
+    if (!it) return false;
+
+    *mean = strtod(it + strlen("\"mean_ms\":"), NULL);
+    return true;
+}
+
+static u32 bench_compare(const char* json, const char* scenario, const bench_stats_t* result, f64 threshold) {
+    u32 regressions = 0;
+
+    for (u32 i = 0; i <= PROFILE_COUNT; ++i) {
+        const char* phase   = i < PROFILE_COUNT? profile_phase_name[i] : "total";
+        f64         current = 1000 * result[i].mean;
+        f64         base    = 0;
+
+        if (!bench_find_baseline(json, scenario, phase, &base)) continue;
+
+        // ignore noise on phases that barely take any time:
+        if (current > base * (1 + threshold) && current - base > 0.01) {
+            fprintf(stderr, "REGRESSION %-12s %-12s %9.4f ms -> %9.4f ms (%+.1f%%)\n", scenario, phase, base, current, 100 * (current / base - 1));
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+
+static u8 memory[GB];
+
+int main(int argc, char** argv) {
+    ma          = ma_create(memory, ARRAY_COUNT(memory));
+    game_state  = ma_type(&ma, game_state_t);
+
+    u32         ticks           = 0;
+    const char* out_path        = NULL;
+    const char* baseline_path   = NULL;
+    f64         threshold       = 0.1;
+
+    b32 selected[ARRAY_COUNT(bench_scenario_array)] = {0};
+    b32 any_selected = false;
+    b32 layout_selected = false;
+    b32 pheromone_selected = false;
+    b32 map_gen_selected = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if      (!strcmp(argv[i], "-ticks")     && i + 1 < argc) { ticks            = atoi(argv[++i]); }
+        else if (!strcmp(argv[i], "-out")       && i + 1 < argc) { out_path         = argv[++i]; }
+        else if (!strcmp(argv[i], "-compare")   && i + 1 < argc) { baseline_path    = argv[++i]; }
+        else if (!strcmp(argv[i], "-threshold") && i + 1 < argc) { threshold        = atof(argv[++i]); }
+        else if (!strcmp(argv[i], "map_layout"))                 { layout_selected  = true; any_selected = true; }
+        else if (!strcmp(argv[i], "pheromone"))                  { pheromone_selected = true; any_selected = true; }
+        else if (!strcmp(argv[i], "map_gen"))                    { map_gen_selected = true; any_selected = true; }
+        else {
+            b32 found = false;
+
+            for (u32 j = 0; j < ARRAY_COUNT(bench_scenario_array); ++j) {
+                if (!strcmp(argv[i], bench_scenario_array[j].name)) {
+                    selected[j]     = true;
+                    any_selected    = true;
+                    found           = true;
+                }
+            }
+
+            if (!found) {
+                fprintf(stderr, "unknown argument: %s\n", argv[i]);
+                return 2;
+            }
+        }
+    }
+
+    char* baseline = NULL;
+
+    if (baseline_path && !(baseline = bench_read_file(baseline_path))) {
+        fprintf(stderr, "could not read baseline: %s\n", baseline_path);
+        return 2;
+    }
+
+    FILE* out = out_path? fopen(out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "could not open: %s\n", out_path);
+        return 2;
+    }
+
+    job_init();
+    save_init();
+    map_gen_init();
+
+    u32 last = 0;
+    for (u32 i = 0; i < ARRAY_COUNT(bench_scenario_array); ++i) {
+        if (!any_selected || selected[i]) last = i;
+    }
+
+    b32 run_layout = !any_selected || layout_selected;
+    b32 run_pheromone = !any_selected || pheromone_selected;
+    b32 run_map_gen = !any_selected || map_gen_selected;
+
+    u32 regressions = 0;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"threads\": %u,\n", job_worker_count + 1);
+    fprintf(out, "  \"scenarios\": [\n");
+
+    for (u32 i = 0; i < ARRAY_COUNT(bench_scenario_array); ++i) {
+        if (any_selected && !selected[i]) continue;
+
+        const bench_scenario_t* scenario = &bench_scenario_array[i];
+        bench_stats_t           result[PROFILE_COUNT + 1];
+
+        bench_run(out, scenario, ticks? ticks : scenario->ticks, result, i == last);
+        fflush(out);
+
+        if (baseline) {
+            regressions += bench_compare(baseline, scenario->name, result, threshold);
+        }
+    }
+
+    fprintf(out, "  ]%s\n", run_layout || run_pheromone || run_map_gen? "," : "");
+
+    if (run_layout) {
+        bench_map_layout(out, !run_pheromone && !run_map_gen);
+    }
+
+    if (run_pheromone) {
+        bench_pheromone(out, !run_map_gen);
+    }
+
+    if (run_map_gen) {
+        bench_map_gen(out, true);
+    }
+
+    fprintf(out, "}\n");
+
+    if (out != stdout) fclose(out);
+
+    if (baseline) {
+        fprintf(stderr, "%u regression(s) over %.0f%%\n", regressions, 100 * threshold);
+    }
+
+    if (bench_minimap_mismatches) {
+        fprintf(stderr, "%u minimap pixel(s) differ from a full rebuild\n", bench_minimap_mismatches);
+    }
+
+    if (bench_pheromone_denormals) {
+        fprintf(stderr, "%u denormal(s) left in the pheromone field\n", bench_pheromone_denormals);
+    }
+
+    if (bench_ant_drift) {
+        fprintf(stderr, "%u tick(s) changed the number of ants\n", bench_ant_drift);
+    }
+
+    if (bench_map_gen_differs) {
+        fprintf(stderr, "map_gen runs differ between the hash rows or the job system\n");
+    }
+
+    return (regressions || bench_minimap_mismatches || bench_pheromone_denormals || bench_ant_drift || bench_map_gen_differs)? 1 : 0;
+}
@@ -0,0 +1,2 @@
+@echo off
+cl bench.c /Fe:bench /O2 /MP /nologo /link /incremental:no
@@ -0,0 +1,258 @@
+
+// Ant level of detail.
+//
+// Idle ants far from every unit and from the camera don't need to be entities. They are folded into a count per
+// COLONY_CHUNK x COLONY_CHUNK chunk, and once a second those counts even out a little between neighbouring chunks,
+// through the open tiles on the edge they share. When a unit or the camera comes within COLONY_NEAR chunks the count is
+// turned back into ants, on tiles picked by hashing the seed, the chunk and how many times it has been materialized, so
+// the same game always puts them in the same places. Ants are only folded again beyond COLONY_FAR chunks, so walking
+// along the edge doesn't make them flicker in and out. Whatever doesn't fit in the entity array stays folded until
+// there is room.
+// The simulation only pays for the ants around the player, however many there are in total.
+
+#define COLONY_CHUNK        (16)
+#define COLONY_ROW          (MAP_SIZE / COLONY_CHUNK)
+#define COLONY_CHUNK_COUNT  (COLONY_ROW * COLONY_ROW)
+#define COLONY_CHUNK_TILES  (COLONY_CHUNK * COLONY_CHUNK)
+#define COLONY_NEAR         (1)
+#define COLONY_FAR          (2)
+#define COLONY_COUNT_MAX    (0xffff)
+#define COLONY_FLOW_TIME    (1.0f)
+// a step moves 1 / COLONY_FLOW_DIV of what it would take to even out two chunks with a fully open edge:
+#define COLONY_FLOW_DIV     (8)
+#define COLONY_SPAWN_MAX    (256)
+
+// saved with the game:
+typedef struct colony_chunk_t {
+    u16     count;
+    u16     epoch;
+} colony_chunk_t;
+
+static colony_chunk_t   colony_chunk_array[COLONY_CHUNK_COUNT];
+static f32              colony_flow_timer;
+
+// open tiles per chunk, and open tile pairs across the right and the top edge of a chunk:
+static b32              colony_map_valid;
+static u32              colony_map_version;
+static u16              colony_open[COLONY_CHUNK_COUNT];
+static u16              colony_portal[COLONY_CHUNK_COUNT][2];
+
+// rebuilt every tick, 'near' is inside 'keep':
+static b8               colony_near[COLONY_CHUNK_COUNT];
+static b8               colony_keep[COLONY_CHUNK_COUNT];
+
+static void colony_init(void) {
+    memset(colony_chunk_array, 0, sizeof (colony_chunk_array));
+
+    colony_flow_timer   = 0;
+    colony_map_valid    = false;
+}
+
+static u32 colony_chunk_index(vec2_t pos) {
+    i32 x = CLAMP((i32)pos.x / COLONY_CHUNK, 0, COLONY_ROW - 1);
+    i32 y = CLAMP((i32)pos.y / COLONY_CHUNK, 0, COLONY_ROW - 1);
+
+    return y * COLONY_ROW + x;
+}
+
+static b32 colony_is_foldable(const entity_t* e) {
+    return e->type == ENTITY_TYPE_ANT && e->ai == AI_ANT_IDLE && e->next_ai == AI_ANT_IDLE;
+}
+
+// everything folded plus the ants that are entities:
+static u32 colony_ant_count(const game_state_t* gs) {
+    u32 count = 0;
+
+    for (u32 i = 0; i < COLONY_CHUNK_COUNT; ++i) {
+        count += colony_chunk_array[i].count;
+    }
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        count += gs->entity_array[i].type == ENTITY_TYPE_ANT;
+    }
+
+    return count;
+}
+
+static void colony_mark(b8* mask, i32 cx, i32 cy, i32 radius) {
+    for (i32 y = MAX(cy - radius, 0); y <= MIN(cy + radius, COLONY_ROW - 1); ++y) {
+        for (i32 x = MAX(cx - radius, 0); x <= MIN(cx + radius, COLONY_ROW - 1); ++x) {
+            mask[y * COLONY_ROW + x] = true;
+        }
+    }
+}
+
+static void colony_build_masks(const game_state_t* gs) {
+    static b8 occupied[COLONY_CHUNK_COUNT];
+
+    memset(occupied,    0, sizeof (occupied));
+    memset(colony_near, 0, sizeof (colony_near));
+    memset(colony_keep, 0, sizeof (colony_keep));
+
+    occupied[colony_chunk_index(gs->cam.pos.xy)] = true;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        const entity_t* e = &gs->entity_array[i];
+
+        if (entity_is_unit(e)) {
+            occupied[colony_chunk_index(e->pos)] = true;
+        }
+    }
+
+    for (u32 i = 0; i < COLONY_CHUNK_COUNT; ++i) {
+        if (!occupied[i]) continue;
+
+        colony_mark(colony_near, i % COLONY_ROW, i / COLONY_ROW, COLONY_NEAR);
+        colony_mark(colony_keep, i % COLONY_ROW, i / COLONY_ROW, COLONY_FAR);
+    }
+}
+
+// counts the idle ants outside 'keep' and has them removed at the flush, returns how many. When there is hardly any
+// room left for new ants it also takes the ones outside 'near', so the chunks close to the player get the room:
+static u32 colony_fold(game_state_t* gs, command_buffer_t* commands) {
+    const b8*   mask    = gs->entity_count > ENTITY_MAX - COLONY_SPAWN_MAX? colony_near : colony_keep;
+    u32         count   = 0;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t*   e       = &gs->entity_array[i];
+        u32         chunk   = colony_chunk_index(e->pos);
+
+        if (colony_is_foldable(e) && !mask[chunk] && colony_chunk_array[chunk].count < COLONY_COUNT_MAX) {
+            colony_chunk_array[chunk].count++;
+            command_despawn(commands, i, i);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void colony_build_map(const map_t* map) {
+    memset(colony_open,     0, sizeof (colony_open));
+    memset(colony_portal,   0, sizeof (colony_portal));
+
+    for (i32 y = 0; y < MAP_SIZE; ++y) {
+        for (i32 x = 0; x < MAP_SIZE; ++x) {
+            if (!map_is_traversable(map, x, y)) continue;
+
+            u32 chunk = (y / COLONY_CHUNK) * COLONY_ROW + x / COLONY_CHUNK;
+
+            colony_open[chunk]++;
+
+            if (x % COLONY_CHUNK == COLONY_CHUNK - 1 && map_is_traversable(map, x + 1, y)) colony_portal[chunk][0]++;
+            if (y % COLONY_CHUNK == COLONY_CHUNK - 1 && map_is_traversable(map, x, y + 1)) colony_portal[chunk][1]++;
+        }
+    }
+
+    colony_map_valid    = true;
+    colony_map_version  = map->version;
+}
+
+// how much goes from 'a' to 'b' (negative for the other way), from the counts before the step so the order of the
+// edges doesn't matter:
+static i32 colony_edge_flow(const u16* count, u32 a, u32 b, u32 portal) {
+    i32 open_a = colony_open[a];
+    i32 open_b = colony_open[b];
+
+    if (portal == 0 || colony_keep[a] || colony_keep[b]) return 0;
+
+    // what would give both the same number of ants per open tile:
+    i32 even = (count[a] * open_b - count[b] * open_a) / (open_a + open_b);
+
+    return even * (i32)portal / (COLONY_CHUNK * COLONY_FLOW_DIV);
+}
+
+static void colony_flow(const map_t* map) {
+    static u16 count[COLONY_CHUNK_COUNT];
+
+    if (!colony_map_valid || colony_map_version != map->version) {
+        colony_build_map(map);
+    }
+
+    for (u32 i = 0; i < COLONY_CHUNK_COUNT; ++i) {
+        count[i] = colony_chunk_array[i].count;
+    }
+
+    for (u32 a = 0; a < COLONY_CHUNK_COUNT; ++a) {
+        u32 x = a % COLONY_ROW;
+        u32 y = a / COLONY_ROW;
+
+        for (u32 side = 0; side < 2; ++side) {
+            if (side == 0? x == COLONY_ROW - 1 : y == COLONY_ROW - 1) continue;
+
+            u32 b       = side == 0? a + 1 : a + COLONY_ROW;
+            i32 flow    = colony_edge_flow(count, a, b, colony_portal[a][side]);
+
+            // whatever a full chunk can't take stays where it is:
+            flow = MIN(flow, COLONY_COUNT_MAX - colony_chunk_array[b].count);
+            flow = MAX(flow, colony_chunk_array[a].count - COLONY_COUNT_MAX);
+
+            // an edge moves at most an eighth of either side, so four of them can't take a chunk below zero:
+            colony_chunk_array[a].count -= flow;
+            colony_chunk_array[b].count += flow;
+        }
+    }
+}
+
+// turns up to 'count' of the chunk back into ants, at most one per open tile, walking the tiles in an order picked by
+// the hash. What doesn't fit stays folded for the next time, a walled in chunk keeps all of them until it is dug out:
+static u32 colony_materialize(game_state_t* gs, command_buffer_t* commands, u32 chunk, u32 count) {
+    colony_chunk_t* c       = &colony_chunk_array[chunk];
+    i32             cx      = (chunk % COLONY_ROW) * COLONY_CHUNK;
+    i32             cy      = (chunk / COLONY_ROW) * COLONY_CHUNK;
+    u32             epoch   = c->epoch++;
+    u32             h       = map_gen_hash(gs->seed, cx, cy, epoch);
+
+    // any odd step visits every tile once before coming back around:
+    u32             start   = h % COLONY_CHUNK_TILES;
+    u32             step    = (h >> 16) | 1;
+    u32             placed  = 0;
+
+    for (u32 k = 0; k < COLONY_CHUNK_TILES && placed < count; ++k) {
+        u32 tile    = (start + k * step) % COLONY_CHUNK_TILES;
+        i32 x       = cx + tile % COLONY_CHUNK;
+        i32 y       = cy + tile / COLONY_CHUNK;
+
+        if (!map_is_traversable(&gs->map, x, y)) continue;
+
+        u32 jitter = map_gen_hash(gs->seed, x, y, epoch);
+
+        command_spawn(commands, chunk, placed, &(entity_desc_t) {
+            .type   = ENTITY_TYPE_ANT,
+            .pos    = v2(x + 0.25f + (jitter & 0xff) * (0.5f / 256), y + 0.25f + ((jitter >> 8) & 0xff) * (0.5f / 256)),
+        });
+
+        placed++;
+    }
+
+    c->count -= placed;
+
+    return placed;
+}
+
+// before the ai, so the buckets get sorted with whatever came and went:
+static void update_colony(game_state_t* gs, f32 dt) {
+    command_buffer_t* commands = command_buffer_get(0);
+
+    colony_build_masks(gs);
+
+    u32 folded = colony_fold(gs, commands);
+
+    colony_flow_timer += dt;
+
+    if (colony_flow_timer >= COLONY_FLOW_TIME) {
+        colony_flow_timer -= COLONY_FLOW_TIME;
+        colony_flow(&gs->map);
+    }
+
+    // the folded ants are gone by the time the new ones are added:
+    u32 budget = MIN(COLONY_SPAWN_MAX, ENTITY_MAX - gs->entity_count + folded);
+
+    for (u32 i = 0; i < COLONY_CHUNK_COUNT && budget > 0; ++i) {
+        if (!colony_near[i] || colony_chunk_array[i].count == 0) continue;
+
+        budget -= colony_materialize(gs, commands, i, MIN(colony_chunk_array[i].count, budget));
+    }
+
+    command_flush(gs);
+}
@@ -0,0 +1,110 @@
+
+// Deferred structural changes.
+//
+// While a system walks the entities it only writes to the entity it is looking at. Anything that touches shared state,
+// like editing or claiming a tile, killing another entity or adding one, is recorded into the command buffer of the
+// thread it runs on (indexed like the job system, 0 is the thread running the simulation). At a sync point
+// 'command_flush' (command_flush.h) gathers every buffer, sorts the commands and applies them, so the result doesn't
+// depend on which thread recorded what or in which order, and removing entities is a single compaction of the entity
+// array. Entities are referred to by their index, which stays valid until the next flush since that is the only place
+// they move. The sort order is the type order below: tile edits, then the player's orders, then releases, then claims,
+// then removals, then additions. Whatever the systems read that isn't an entity (groups, the entity grid, visible ants,
+// path handles) is brought up to date by 'prepare_entity_ai' before any of them runs.
+// Two things still keep the systems on one thread: the flood fills of 'find_work' and 'find_closest_bug' share the
+// path finder's queue and visited set, and group members fold their distances into their group with a MAX.
+
+// an entity records at most two commands a tick, and the colony at most one per entity plus its spawns:
+#define COMMAND_MAX (4 * ENTITY_MAX)
+
+typedef u32 command_type_t;
+enum {
+    COMMAND_NONE,
+    COMMAND_SET_TILE,
+    COMMAND_DESTROY_TILE,
+    COMMAND_SET_ORDER,
+    COMMAND_RELEASE_TILE,
+    COMMAND_CLAIM_TILE,
+    COMMAND_DESPAWN,
+    COMMAND_SPAWN,
+    //
+    COMMAND_COUNT,
+};
+
+typedef struct command_t {
+    command_type_t  type;
+    // a tile (y * MAP_SIZE + x) or an entity index, spawns use it as a sort key:
+    u32             target;
+    // commands on the same target are applied lowest first, for claims this is the distance:
+    u32             order;
+    // the index of the entity that recorded it, breaks ties:
+    u32             issuer;
+
+    union {
+        tile_type_t     tile_type;
+        order_type_t    order_type;
+        entity_desc_t   spawn;
+    };
+} command_t;
+
+typedef struct command_buffer_t {
+    u32             count;
+    command_t       array[COMMAND_MAX];
+} command_buffer_t;
+
+static command_buffer_t command_buffer_array[JOB_THREAD_MAX];
+
+static command_buffer_t* command_buffer_get(u32 thread_index) {
+    return &command_buffer_array[thread_index];
+}
+
+static void command_push(command_buffer_t* buffer, const command_t* command) {
+    if (buffer->count < COMMAND_MAX) {
+        buffer->array[buffer->count++] = *command;
+    }
+}
+
+static u32 command_tile_target(i32 x, i32 y) {
+    return (u32)y * MAP_SIZE + (u32)x;
+}
+
+static void command_set_tile(command_buffer_t* buffer, u32 issuer, i32 x, i32 y, tile_type_t type) {
+    command_push(buffer, &(command_t) {
+        .type       = COMMAND_SET_TILE,
+        .target     = command_tile_target(x, y),
+        .issuer     = issuer,
+        .tile_type  = type,
+    });
+}
+
+static void command_destroy_tile(command_buffer_t* buffer, u32 issuer, i32 x, i32 y) {
+    command_push(buffer, &(command_t) { .type = COMMAND_DESTROY_TILE, .target = command_tile_target(x, y), .issuer = issuer });
+}
+
+// from the player, not an entity. Clearing the order also frees the tile from whoever was working on it:
+static void command_set_order(command_buffer_t* buffer, i32 x, i32 y, order_type_t order) {
+    command_push(buffer, &(command_t) { .type = COMMAND_SET_ORDER, .target = command_tile_target(x, y), .order_type = order });
+}
+
+// gives up the tile, if 'issuer' still holds it by then:
+static void command_release_tile(command_buffer_t* buffer, u32 issuer, i32 x, i32 y) {
+    command_push(buffer, &(command_t) { .type = COMMAND_RELEASE_TILE, .target = command_tile_target(x, y), .issuer = issuer });
+}
+
+// the closest claim on a tile wins it, taking it from whoever held it:
+static void command_claim_tile(command_buffer_t* buffer, u32 issuer, i32 x, i32 y, f32 dist) {
+    command_push(buffer, &(command_t) {
+        .type       = COMMAND_CLAIM_TILE,
+        .target     = command_tile_target(x, y),
+        .order      = (u32)(dist * 1024),
+        .issuer     = issuer,
+    });
+}
+
+static void command_despawn(command_buffer_t* buffer, u32 issuer, u32 index) {
+    command_push(buffer, &(command_t) { .type = COMMAND_DESPAWN, .target = index, .issuer = issuer });
+}
+
+// 'key' and 'order' only decide the order the spawns are added in:
+static void command_spawn(command_buffer_t* buffer, u32 key, u32 order, const entity_desc_t* desc) {
+    command_push(buffer, &(command_t) { .type = COMMAND_SPAWN, .target = key, .order = order, .spawn = *desc });
+}
@@ -0,0 +1,133 @@
+
+// Applying the commands recorded during a tick, see command.h. Comes after every system whose handles an entity
+// holds, since removing an entity releases them.
+
+static int command_compare(const void* a, const void* b) {
+    const command_t* x = a;
+    const command_t* y = b;
+
+    if (x->type     != y->type)     return x->type      < y->type?      -1 : 1;
+    if (x->target   != y->target)   return x->target    < y->target?    -1 : 1;
+    if (x->order    != y->order)    return x->order     < y->order?     -1 : 1;
+    if (x->issuer   != y->issuer)   return x->issuer    < y->issuer?    -1 : 1;
+
+    return 0;
+}
+
+static void command_claim(game_state_t* gs, const command_t* command) {
+    i32         x       = command->target % MAP_SIZE;
+    i32         y       = command->target / MAP_SIZE;
+    tile_t*     tile    = map_get_tile(&gs->map, x, y);
+    entity_t*   worker  = &gs->entity_array[command->issuer];
+
+    // dug out or cancelled since it was claimed:
+    if (!tile->order || tile->worker_id == worker->id) return;
+
+    entity_t* holder = tile->worker_id? get_entity(gs, tile->worker_id) : NULL;
+
+    if (holder) {
+        entity_set_ai(holder, AI_WORKER_IDLE);
+        holder->target_pos = holder->pos;
+    }
+
+    tile->worker_id = worker->id;
+
+    entity_set_ai(worker, AI_WORKER_EXECUTE_ORDER);
+    worker->target_pos = v2(x + 0.5, y + 0.5);
+}
+
+// removes the marked entities and the ones without life left, keeping the order of the rest:
+static void command_compact(game_state_t* gs, b8* dead) {
+    u32 count = 0;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        if (dead[i] || e->life <= 0) {
+            dead[i] = false;
+
+            if (e->selected) gs->selected_count--;
+
+            // the tile it was working on is free again:
+            if (e->ai == AI_WORKER_EXECUTE_ORDER) {
+                tile_t* tile = map_get_tile(&gs->map, e->target_pos.x, e->target_pos.y);
+                if (tile && tile->worker_id == e->id) tile->worker_id = 0;
+            }
+
+            path_service_release(e->path_handle);
+            vis_release(e->vis_handle);
+            group_leave(e);
+            continue;
+        }
+
+        if (count != i) gs->entity_array[count] = *e;
+        count++;
+    }
+
+    if (count != gs->entity_count) {
+        gs->entity_count    = count;
+        gs->ai_dirty        = true;
+    }
+}
+
+// a sync point, nothing may be recording while it runs:
+static void command_flush(game_state_t* gs) {
+    static command_t    sorted[JOB_THREAD_MAX * COMMAND_MAX];
+    static b8           dead[ENTITY_MAX];
+
+    u32 count = 0;
+
+    for (u32 i = 0; i < JOB_THREAD_MAX; ++i) {
+        command_buffer_t* buffer = &command_buffer_array[i];
+
+        memcpy(sorted + count, buffer->array, buffer->count * sizeof (command_t));
+
+        count           += buffer->count;
+        buffer->count    = 0;
+    }
+
+    qsort(sorted, count, sizeof (command_t), command_compare);
+
+    u32 i = 0;
+
+    for (; i < count && sorted[i].type < COMMAND_DESPAWN; ++i) {
+        const command_t* command = &sorted[i];
+
+        i32 x = command->target % MAP_SIZE;
+        i32 y = command->target / MAP_SIZE;
+
+        switch (command->type) {
+            case COMMAND_SET_TILE: {
+                map_set_tile(&gs->map, x, y, command->tile_type);
+            } break;
+            case COMMAND_DESTROY_TILE: {
+                map_destroy_tile(&gs->map, x, y);
+            } break;
+            case COMMAND_SET_ORDER: {
+                tile_t* tile = map_get_tile(&gs->map, x, y);
+
+                tile->order = command->order_type;
+                if (!tile->order) tile->worker_id = 0;
+            } break;
+            case COMMAND_RELEASE_TILE: {
+                tile_t* tile = map_get_tile(&gs->map, x, y);
+                if (tile->worker_id == gs->entity_array[command->issuer].id) tile->worker_id = 0;
+            } break;
+            case COMMAND_CLAIM_TILE: {
+                // only the closest claim on a tile counts, the others try again next tick:
+                if (i > 0 && sorted[i - 1].type == COMMAND_CLAIM_TILE && sorted[i - 1].target == command->target) break;
+                command_claim(gs, command);
+            } break;
+        }
+    }
+
+    for (; i < count && sorted[i].type == COMMAND_DESPAWN; ++i) {
+        dead[sorted[i].target] = true;
+    }
+
+    command_compact(gs, dead);
+
+    for (; i < count; ++i) {
+        add_entity(gs, &sorted[i].spawn);
+    }
+}
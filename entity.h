@@ -22,7 +22,10 @@ enum {
     AI_GUARD_KILL_TARGET,
     // Ant AI:
     AI_ANT_IDLE,
+    AI_ANT_FOLLOW,
     AI_ANT_AGRO,
+    // Unit AI:
+    AI_UNIT_MOVE,
     //
     AI_Count,
 };
@@ -31,6 +34,7 @@ typedef struct entity_info_t {
     ai_type_t   ai;
     f32         rad;
     u32         color;
+    u32         light;
     f32         max_life;
     
     char        name[32];
@@ -46,6 +50,7 @@ static entity_info_t entity_info_table[ENTITY_TYPE_COUNT] = {
     [ENTITY_TYPE_WORKER] = {
         .name       = "worker",
         .texture    = "human",
+        .light      = 10,
         .ai         = AI_WORKER_IDLE,
         .rad        = 0.24,
         .color      = 0xff22bb22,
@@ -55,6 +60,7 @@ static entity_info_t entity_info_table[ENTITY_TYPE_COUNT] = {
     [ENTITY_TYPE_GUARD] = {
         .name       = "guard",
         .texture    = "human",
+        .light      = 10,
         .ai         = AI_GUARD_IDLE,
         .rad        = 0.24,
         .color      = 0xffbb4422,
@@ -86,11 +92,39 @@ typedef struct entity_t {
     f32             life;
 
     ai_type_t       ai;
+    // set by 'entity_set_ai', becomes 'ai' when the buckets are sorted:
+    ai_type_t       next_ai;
 
     u32             target_id;
     vec2_t          target_pos;
+
+    u32             path_handle;
+    u32             vis_handle;
+
+    // set while in AI_UNIT_MOVE, 'group_slot' is the place in the formation:
+    u32             group_handle;
+    u32             group_slot;
+
+    b32             selected;
+
+    // resting entities skip integration and tile collisions until something wakes them:
+    b32             asleep;
+    f32             rest_time;
 } entity_t;
 
+#define ENTITY_SLEEP_VELOCITY   (0.05)
+#define ENTITY_SLEEP_DEPTH      (0.01)
+#define ENTITY_SLEEP_TIME       (0.5)
+
+static void entity_wake(entity_t* e) {
+    e->asleep       = false;
+    e->rest_time    = 0;
+}
+
+static b32 entity_is_unit(const entity_t* e) {
+    return e->type == ENTITY_TYPE_WORKER || e->type == ENTITY_TYPE_GUARD;
+}
+
 static const entity_info_t* entity_get_info(const entity_t* e) {
     return &entity_info_table[e->type];
 }
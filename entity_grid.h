@@ -0,0 +1,121 @@
+// Uniform grid over the map with one cell per tile, rebuilt once a tick right after the entities move (see
+// 'handle_entity_collisions'). Entities off the map are clamped into the border cells.
+// The build is a radix sort of the entities by cell, so its cost follows the entity count and not the map size: each
+// cell only keeps where its run of entries starts, and only the cells the last build filled are cleared again.
+// The indices are only good until the entity array changes order again. The ai of the next tick runs after that, so
+// each entry also keeps the id, position and radius the entity had at the end of the last tick.
+
+typedef struct entity_grid_entry_t {
+    u32     cell;
+    u32     index;
+    u32     id;
+    vec2_t  pos;
+    f32     rad;
+} entity_grid_entry_t;
+
+typedef struct entity_grid_t {
+    // first entry of each cell plus one, 0 for an empty cell:
+    u32                 cell_first[MAP_SIZE * MAP_SIZE];
+
+    // sorted by cell, in entity order within a cell:
+    u32                 entry_count;
+    entity_grid_entry_t entry_array[ENTITY_MAX];
+
+    // entity index -> its entry:
+    u32                 entity_entry[ENTITY_MAX];
+} entity_grid_t;
+
+static entity_grid_t entity_grid;
+
+static u32 entity_grid_cell(vec2_t pos) {
+    i32 x = CLAMP((i32)pos.x, 0, MAP_SIZE - 1);
+    i32 y = CLAMP((i32)pos.y, 0, MAP_SIZE - 1);
+
+    return y * MAP_SIZE + x;
+}
+
+static void entity_grid_build(entity_grid_t* grid, const game_state_t* gs) {
+    static u32 cell[ENTITY_MAX];
+    static u32 order[2][ENTITY_MAX];
+
+    for (u32 i = 0; i < grid->entry_count; ++i) {
+        grid->cell_first[grid->entry_array[i].cell] = 0;
+    }
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        cell[i]     = entity_grid_cell(gs->entity_array[i].pos);
+        order[0][i] = i;
+    }
+
+    // a byte of the cell per pass, lowest first. Each pass keeps the order of the last one, so the entities of a cell
+    // stay in entity order:
+    u32 src = 0;
+
+    for (u32 shift = 0; (1u << shift) < MAP_SIZE * MAP_SIZE; shift += 8) {
+        u32 start[256] = {0};
+
+        for (u32 i = 0; i < gs->entity_count; ++i) {
+            start[(cell[i] >> shift) & 255]++;
+        }
+
+        for (u32 i = 0, sum = 0; i < 256; ++i) {
+            u32 count = start[i];
+
+            start[i] = sum;
+            sum += count;
+        }
+
+        for (u32 i = 0; i < gs->entity_count; ++i) {
+            u32 index = order[src][i];
+            order[!src][start[(cell[index] >> shift) & 255]++] = index;
+        }
+
+        src = !src;
+    }
+
+    grid->entry_count = gs->entity_count;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        u32             index   = order[src][i];
+        const entity_t* e       = &gs->entity_array[index];
+
+        grid->entry_array[i] = (entity_grid_entry_t) {
+            .cell   = cell[index],
+            .index  = index,
+            .id     = e->id,
+            .pos    = e->pos,
+            .rad    = entity_get_info(e)->rad,
+        };
+
+        grid->entity_entry[index] = i;
+
+        if (!grid->cell_first[cell[index]]) {
+            grid->cell_first[cell[index]] = i + 1;
+        }
+    }
+}
+
+// picks up where the entities in 'index_array' ended up, they stay in the cells they were sorted into:
+static void entity_grid_refresh(entity_grid_t* grid, const game_state_t* gs, const u32* index_array, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        u32 index = index_array[i];
+        grid->entry_array[grid->entity_entry[index]].pos = gs->entity_array[index].pos;
+    }
+}
+
+// the first entry in 'cell', or the end of the entries if it has none:
+static u32 entity_grid_first(const entity_grid_t* grid, u32 cell) {
+    u32 first = grid->cell_first[cell];
+    return first? first - 1 : grid->entry_count;
+}
+
+// iterates the entries in tile (x, y), which has to be on the map:
+#define for_entity_grid_entry(grid, x, y, entry) \
+    for (const entity_grid_entry_t* entry = &(grid)->entry_array[entity_grid_first((grid), (y) * MAP_SIZE + (x))], \
+         *entry##_end = &(grid)->entry_array[(grid)->entry_count]; \
+         entry != entry##_end && entry->cell == (u32)((y) * MAP_SIZE + (x)); ++entry)
+
+// iterates the entity indices in tile (x, y), only while the entity order is the one the grid was built for:
+#define for_entity_grid(grid, x, y, i) \
+    for (u32 _c = (y) * MAP_SIZE + (x), _k = entity_grid_first((grid), _c), i = 0; \
+         _k < (grid)->entry_count && (grid)->entry_array[_k].cell == _c && ((i = (grid)->entry_array[_k].index), true); ++_k)
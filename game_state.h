@@ -3,15 +3,28 @@
 #define PARTICLE_MAX    (8 * 1024)
 
 typedef struct game_state_t {
+    u32             seed;
+
     camera_t        cam;
     map_t           map;
 
     order_type_t    order_tool;
 
+    // box selection, dragged from 'select_start' to 'select_end':
+    b32             selecting;
+    vec2_t          select_start;
+    vec2_t          select_end;
+    u32             selected_count;
+
     u32             next_id;
     u32             entity_count;
     entity_t        entity_array[ENTITY_MAX];
 
+    // entity_array is sorted by ai state, the entities in state 'ai' are [ai_bucket[ai], ai_bucket[ai + 1]).
+    // 'ai_dirty' is set when entities are added or removed, state changes are found by looking at 'next_ai':
+    b32             ai_dirty;
+    u32             ai_bucket[AI_Count + 1];
+
     u32             particle_count;
     particle_t      particle_array[PARTICLE_MAX];
 } game_state_t;
@@ -28,10 +41,68 @@ static entity_t* add_entity(game_state_t* gs, const entity_desc_t* desc) {
     e->vel      = desc->vel;
     e->life     = info->max_life;
     e->ai       = info->ai;
+    e->next_ai  = info->ai;
+
+    e->target_id    = 0;
+    e->target_pos   = desc->pos;
+    e->path_handle  = 0;
+    e->vis_handle   = 0;
+    e->group_handle = 0;
+    e->group_slot   = 0;
+    e->selected     = false;
+
+    e->asleep       = false;
+    e->rest_time    = 0;
+
+    gs->ai_dirty    = true;
 
     return e;
 }
 
+// the entity keeps its current state (and bucket) until the next 'sort_entity_buckets'. Only touches 'e', so the ai
+// systems can call it on their own entities from any thread:
+static void entity_set_ai(entity_t* e, ai_type_t ai) {
+    e->next_ai = ai;
+}
+
+// applies the pending state changes and regroups entity_array by state, keeping the order within a state:
+static void sort_entity_buckets(game_state_t* gs) {
+    static entity_t sorted[ENTITY_MAX];
+
+    if (!gs->ai_dirty) {
+        u32 i = 0;
+        while (i < gs->entity_count && gs->entity_array[i].next_ai == gs->entity_array[i].ai) ++i;
+
+        if (i == gs->entity_count) return;
+    }
+
+    u32 count[AI_Count] = {0};
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        e->ai = e->next_ai;
+        count[e->ai]++;
+    }
+
+    gs->ai_bucket[0] = 0;
+
+    for (u32 ai = 0; ai < AI_Count; ++ai) {
+        gs->ai_bucket[ai + 1] = gs->ai_bucket[ai] + count[ai];
+    }
+
+    u32 next[AI_Count];
+    memcpy(next, gs->ai_bucket, sizeof (next));
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        sorted[next[gs->entity_array[i].ai]++] = gs->entity_array[i];
+    }
+
+    memcpy(gs->entity_array, sorted, gs->entity_count * sizeof (entity_t));
+
+    gs->ai_dirty = false;
+}
+
 static entity_t* get_entity(game_state_t* gs, u32 id) {
     for (u32 i = 0; i < gs->entity_count; ++i) {
         entity_t* e = &gs->entity_array[i];
@@ -57,7 +128,7 @@ static void add_particle(game_state_t* gs, const particle_desc_t* desc) {
     u32 count = CLAMP_MIN(desc->count, 1);
 
     for (u32 i = 0; (i < count) && (gs->particle_count < PARTICLE_MAX); ++i) {
-        particle_t* p = &gs->particle_array[gs->entity_count++];
+        particle_t* p = &gs->particle_array[gs->particle_count++];
 
         p->pos          = v3_add(desc->pos, v3_scale(rand_unit_v3(&rs), desc->rand.pos));
         p->vel          = v3_add(desc->vel, v3_scale(rand_unit_v3(&rs), desc->rand.vel));
@@ -0,0 +1,268 @@
+
+// Group moves.
+//
+// Units ordered to move together share a single path: the group owns one path service handle and a leader point walks
+// its corridor towards the destination, dropping a trail behind it. Every member steers straight at its formation slot
+// around the leader point, or at the newest bit of trail it can see when a wall is in the way, so the pathfinding cost
+// of a move doesn't grow with the size of the group. Only a member that can't see any of it looks for a path of its own.
+// The leader waits for members that fall behind, and the move is over once it has arrived and the members have settled
+// into their slots.
+
+#define GROUP_MAX           (64)
+#define GROUP_SPACING       (0.6f)
+#define GROUP_SPEED         (1.2f)
+#define GROUP_SPEED_MIN     (0.25f)
+#define GROUP_LAG_MAX       (1.5f)
+#define GROUP_SETTLE_RADIUS (0.25f)
+#define GROUP_SETTLE_TIME   (2.0f)
+#define GROUP_TRAIL_MAX     (32)
+#define GROUP_TRAIL_STEP    (0.5f)
+
+typedef struct group_t {
+    b32     in_use;
+    b32     done;
+
+    u32     member_count;
+    u32     path_handle;
+
+    // the leader point, the formation is laid out around it:
+    vec2_t  pos;
+    vec2_t  target;
+
+    // fixed when the order is given:
+    vec2_t  forward;
+    vec2_t  right;
+    u32     slot_count;
+    u32     column_count;
+    f32     radius;
+
+    // furthest any member is from the leader point and from its slot, the 'next_' ones are gathered during the tick:
+    f32     leader_dist;
+    f32     slot_dist;
+    f32     next_leader_dist;
+    f32     next_slot_dist;
+    f32     settle_time;
+
+    // where the leader has been, a ring with the newest point at 'trail_head':
+    u32     trail_head;
+    u32     trail_count;
+    vec2_t  trail_array[GROUP_TRAIL_MAX];
+} group_t;
+
+typedef struct group_member_t {
+    f32         key;
+    entity_t*   e;
+} group_member_t;
+
+static group_t          group_array[GROUP_MAX];
+static u32              group_free_count;
+static u32              group_free_array[GROUP_MAX];
+
+static group_member_t   group_member_array[ENTITY_MAX];
+
+// also used to start over, after 'path_service_init' since the handles it holds are gone:
+static void group_init(void) {
+    memset(group_array, 0, sizeof (group_array));
+
+    group_free_count = 0;
+
+    for (u32 i = GROUP_MAX; i > 0; --i) {
+        group_free_array[group_free_count++] = i;
+    }
+}
+
+static group_t* group_get(u32 handle) {
+    if (handle == 0 || handle > GROUP_MAX) return NULL;
+
+    group_t* group = &group_array[handle - 1];
+    return group->in_use? group : NULL;
+}
+
+static void group_leave(entity_t* e) {
+    group_t* group = group_get(e->group_handle);
+
+    e->group_handle = 0;
+    e->group_slot   = 0;
+
+    if (!group || --group->member_count > 0) return;
+
+    path_service_release(group->path_handle);
+
+    group->in_use = false;
+    group_free_array[group_free_count++] = (u32)(group - group_array) + 1;
+}
+
+static vec2_t group_slot_pos(const group_t* group, u32 slot) {
+    u32 row_count   = (group->slot_count + group->column_count - 1) / group->column_count;
+    u32 row         = slot / group->column_count;
+    u32 column      = slot % group->column_count;
+
+    // the last row may be short, keep it centered:
+    u32 row_size    = MIN(group->column_count, group->slot_count - row * group->column_count);
+
+    f32 side        = (column - 0.5f * (row_size - 1)) * GROUP_SPACING;
+    f32 ahead       = (0.5f * (row_count - 1) - row) * GROUP_SPACING;
+
+    return v2_add(group->pos, v2_add(v2_scale(group->right, side), v2_scale(group->forward, ahead)));
+}
+
+static void group_trail_push(group_t* group) {
+    group->trail_head = (group->trail_head + 1) % GROUP_TRAIL_MAX;
+    group->trail_count = MIN(group->trail_count + 1, GROUP_TRAIL_MAX);
+    group->trail_array[group->trail_head] = group->pos;
+}
+
+// the newest trail point in sight of 'pos':
+static b32 group_find_trail(const group_t* group, const map_t* map, vec2_t pos, vec2_t* out) {
+    const vec2i_t no_goal = { -1, -1 };
+
+    for (u32 i = 0; i < group->trail_count; ++i) {
+        vec2_t point = group->trail_array[(group->trail_head + GROUP_TRAIL_MAX - i) % GROUP_TRAIL_MAX];
+
+        if (path_line_of_sight(pos, point, map, NULL, no_goal)) {
+            *out = point;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int group_compare_member(const void* a, const void* b) {
+    f32 x = ((const group_member_t*)a)->key;
+    f32 y = ((const group_member_t*)b)->key;
+
+    return (x > y) - (x < y);
+}
+
+// sends the selected units to 'target' as one group, the tiles they were working on are released through 'commands':
+static void group_order_move(game_state_t* gs, command_buffer_t* commands, vec2_t target) {
+    if (!map_is_traversable(&gs->map, target.x, target.y) || group_free_count == 0) return;
+
+    u32     count       = 0;
+    vec2_t  centroid    = v2(0);
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        if (e->selected && entity_is_unit(e)) {
+            group_member_array[count++].e = e;
+            centroid = v2_add(centroid, e->pos);
+        }
+    }
+
+    if (count == 0) return;
+
+    centroid = v2_scale(centroid, 1.0f / count);
+
+    u32         handle  = group_free_array[--group_free_count];
+    group_t*    group   = &group_array[handle - 1];
+
+    *group = (group_t) {
+        .in_use         = true,
+        .path_handle    = path_service_acquire(),
+        .target         = target,
+        .forward        = v2_norm(v2_sub(target, centroid)),
+        .slot_count     = count,
+        .column_count   = (u32)ceilf(sqrtf(count)),
+    };
+
+    group->radius = 0.75f * group->column_count * GROUP_SPACING;
+
+    if (group->forward.x == 0 && group->forward.y == 0) {
+        group->forward = v2(0, 1);
+    }
+
+    group->right = v2(group->forward.y, -group->forward.x);
+
+    // front to back into rows, then left to right within a row, so nobody has to cross the formation:
+    for (u32 i = 0; i < count; ++i) {
+        group_member_array[i].key = -v2_dot(v2_sub(group_member_array[i].e->pos, centroid), group->forward);
+    }
+
+    qsort(group_member_array, count, sizeof (group_member_t), group_compare_member);
+
+    for (u32 row = 0; row < count; row += group->column_count) {
+        u32 row_size = MIN(group->column_count, count - row);
+
+        for (u32 i = row; i < row + row_size; ++i) {
+            group_member_array[i].key = v2_dot(v2_sub(group_member_array[i].e->pos, centroid), group->right);
+        }
+
+        qsort(group_member_array + row, row_size, sizeof (group_member_t), group_compare_member);
+    }
+
+    // the leader starts on the member closest to the middle, which is known to stand somewhere open:
+    f32 closest = 1e30f;
+
+    for (u32 i = 0; i < count; ++i) {
+        entity_t* e = group_member_array[i].e;
+
+        if (v2_dist_sq(e->pos, centroid) < closest) {
+            closest     = v2_dist_sq(e->pos, centroid);
+            group->pos  = e->pos;
+        }
+    }
+
+    group_trail_push(group);
+
+    for (u32 i = 0; i < count; ++i) {
+        entity_t* e = group_member_array[i].e;
+
+        // drop whatever it was doing:
+        if (e->ai == AI_WORKER_EXECUTE_ORDER) {
+            command_release_tile(commands, (u32)(e - gs->entity_array), e->target_pos.x, e->target_pos.y);
+        }
+
+        group_leave(e);
+
+        // only needed if it gets separated from the group:
+        path_service_release(e->path_handle);
+
+        e->path_handle  = 0;
+        e->target_id    = 0;
+        e->group_handle = handle;
+        e->group_slot   = i;
+
+        group->member_count++;
+        entity_set_ai(e, AI_UNIT_MOVE);
+    }
+}
+
+// moves the leader points, once per tick before the members steer:
+static void update_groups(game_state_t* gs, f32 dt) {
+    for (u32 i = 0; i < GROUP_MAX; ++i) {
+        group_t* group = &group_array[i];
+
+        if (!group->in_use || group->done) continue;
+
+        group->leader_dist      = group->next_leader_dist;
+        group->slot_dist        = group->next_slot_dist;
+        group->next_leader_dist = 0;
+        group->next_slot_dist   = 0;
+
+        if (v2_dist_sq(group->pos, group->target) > PATH_ARRIVE_RADIUS * PATH_ARRIVE_RADIUS) {
+            // slows down for stragglers, measured from the leader and not the slots since members squeezing through a
+            // door can't be in formation. It never stops, so a member stuck behind the others can't hold everyone up:
+            f32     lag     = group->leader_dist - group->radius;
+            f32     speed   = GROUP_SPEED * CLAMP(1 - lag / GROUP_LAG_MAX, GROUP_SPEED_MIN, 1);
+            vec2_t  dir     = path_service_steer(group->path_handle, &gs->map, group->pos, group->target);
+
+            group->pos = v2_add(group->pos, v2_scale(dir, speed * dt));
+
+            if (v2_dist(group->pos, group->trail_array[group->trail_head]) >= GROUP_TRAIL_STEP) {
+                group_trail_push(group);
+            }
+
+            if (!group->path_handle || path_service_is_unreachable(group->path_handle)) {
+                group->done = true;
+            }
+        } else {
+            group->settle_time += dt;
+
+            if (group->slot_dist < GROUP_SETTLE_RADIUS || group->settle_time > GROUP_SETTLE_TIME) {
+                group->done = true;
+            }
+        }
+    }
+}
@@ -1,18 +1,20 @@
 
-static void generate_map(map_t* map) {
-    for_map(x, y) {
-        tile_type_t tile_type = TILE_TYPE_ROCK;
+static void generate_map(map_t* map, u32 seed) {
+    static tile_type_t tile_types[MAP_SIZE * MAP_SIZE];
 
-        if (rand_i32(&rs, 0, 100) < 10 || v2_dist_sq(v2(x + 0.5, y + 0.5), v2(0.5 * MAP_SIZE, 0.5 * MAP_SIZE)) < 3 * 3) {
-            tile_type = TILE_TYPE_COPPER;
-        }
+    map_gen_desc_t desc = {
+        .seed           = seed,
+        .spawn          = v2(0.5 * MAP_SIZE, 0.5 * MAP_SIZE),
+        .spawn_radius   = 3,
+    };
 
-        if (rand_i32(&rs, 0, 100) < 15 || v2_dist_sq(v2(x + 0.5, y + 0.5), v2(0.5 * MAP_SIZE, 0.5 * MAP_SIZE)) < 3 * 3) {
-            tile_type = TILE_TYPE_DIRT;
-        }
+    map_gen_area(&desc, MAP_SIZE, MAP_SIZE, tile_types);
 
-        init_tile(&map->tiles[y][x], tile_type);
+    for_map(x, y) {
+        init_tile(&map->tiles[map_index(x, y)], tile_types[y * MAP_SIZE + x]);
     }
+
+    map->version++;
 }
 
 static void init_game(game_state_t* gs) {
@@ -24,7 +26,12 @@ static void init_game(game_state_t* gs) {
 
     gs->order_tool = ORDER_TYPE_DESTROY_TILE;
 
-    generate_map(&gs->map);
+    gs->selecting       = false;
+    gs->selected_count  = 0;
+
+    gs->seed = rand_u32(&rs);
+
+    generate_map(&gs->map, gs->seed);
 
     for (u32 i = 0; i < 3; ++i) {
         add_entity(gs, &(entity_desc_t) {
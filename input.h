@@ -0,0 +1,31 @@
+
+// Input as the simulation sees it. The main thread captures it from the platform once per frame, so the simulation
+// never touches 'platform' or 'mouse_position' and can run on another thread.
+
+typedef struct input_t {
+    vec3_t  mouse_position;
+    vec2_t  scroll;
+
+    b32     key_down[KEY_LAST];
+    b32     key_pressed[KEY_LAST];
+
+    b32     mouse_down[MOUSE_BUTTON_LAST];
+    b32     mouse_pressed[MOUSE_BUTTON_LAST];
+} input_t;
+
+static input_t input;
+
+static void input_capture(input_t* in, vec3_t mouse_position) {
+    in->mouse_position  = mouse_position;
+    in->scroll          = platform.mouse.scroll;
+
+    for (u32 i = 0; i < KEY_LAST; ++i) {
+        in->key_down[i]     = platform.keyboard.down[i];
+        in->key_pressed[i]  = platform.keyboard.pressed[i];
+    }
+
+    for (u32 i = 0; i < MOUSE_BUTTON_LAST; ++i) {
+        in->mouse_down[i]       = platform.mouse.down[i];
+        in->mouse_pressed[i]    = platform.mouse.pressed[i];
+    }
+}
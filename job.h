@@ -0,0 +1,129 @@
+
+// thread index 0 is always the main thread, workers are 1..job_worker_count.
+#define JOB_THREAD_MAX  (16)
+#define JOB_QUEUE_MAX   (64)
+
+typedef void job_proc_t(void* data, u32 index, u32 thread_index);
+
+typedef struct job_batch_t {
+    job_proc_t*     proc;
+    void*           data;
+    u32             count;
+
+    u32             next;   // guarded by job_mutex
+    volatile u32    done;
+} job_batch_t;
+
+static u32          job_worker_count;
+static mutex_t      job_mutex;
+static semaphore_t  job_semaphore;
+
+static u32          job_queue_count;
+static job_batch_t* job_queue[JOB_QUEUE_MAX];
+
+// claims one item from 'only' (or from any queued batch if 'only' is NULL) and runs it:
+static b32 job_execute(job_batch_t* only, u32 thread_index) {
+    job_batch_t*    batch = NULL;
+    u32             index = 0;
+
+    mutex_lock(&job_mutex);
+
+    for (u32 i = 0; i < job_queue_count; ++i) {
+        job_batch_t* it = job_queue[i];
+
+        if (only && it != only) continue;
+
+        batch = it;
+        index = it->next++;
+
+        // fully claimed, so no one else needs to see it:
+        if (it->next >= it->count) {
+            job_queue[i] = job_queue[--job_queue_count];
+        }
+
+        break;
+    }
+
+    mutex_unlock(&job_mutex);
+
+    if (!batch) return false;
+
+    batch->proc(batch->data, index, thread_index);
+    atomic_inc_u32(&batch->done);
+
+    return true;
+}
+
+static void job_worker(void* arg) {
+    u32 thread_index = (u32)(uintptr_t)arg;
+
+    while (true) {
+        semaphore_wait(&job_semaphore);
+        while (job_execute(NULL, thread_index));
+    }
+}
+
+static void job_init(void) {
+    mutex_init(&job_mutex);
+    semaphore_init(&job_semaphore);
+
+    u32 count = CLAMP(thread_cpu_count() - 1, 1, JOB_THREAD_MAX - 1);
+
+    for (u32 i = 0; i < count; ++i) {
+        if (thread_start(job_worker, (void*)(uintptr_t)(i + 1))) {
+            job_worker_count++;
+        }
+    }
+}
+
+// never blocks, poll with 'job_is_done':
+static void job_submit(job_batch_t* batch, job_proc_t* proc, void* data, u32 count) {
+    batch->proc     = proc;
+    batch->data     = data;
+    batch->count    = count;
+    batch->next     = 0;
+    batch->done     = 0;
+
+    if (count == 0) return;
+
+    b32 queued = false;
+
+    if (job_worker_count > 0) {
+        mutex_lock(&job_mutex);
+        if (job_queue_count < JOB_QUEUE_MAX) {
+            job_queue[job_queue_count++] = batch;
+            queued = true;
+        }
+        mutex_unlock(&job_mutex);
+    }
+
+    // queue is full or there are no workers, so run it right here:
+    if (!queued) {
+        for (u32 i = 0; i < count; ++i) {
+            proc(data, i, 0);
+        }
+
+        batch->next = count;
+        atomic_store_u32(&batch->done, count);
+        return;
+    }
+
+    semaphore_post(&job_semaphore, MIN(count, job_worker_count));
+}
+
+static b32 job_is_done(job_batch_t* batch) {
+    return atomic_load_u32(&batch->done) >= batch->count;
+}
+
+// the calling thread helps out with the batch instead of sleeping:
+static void job_wait(job_batch_t* batch, u32 thread_index) {
+    while (job_execute(batch, thread_index));
+    while (!job_is_done(batch)) thread_yield();
+}
+
+static void job_run(job_proc_t* proc, void* data, u32 count) {
+    job_batch_t batch = {0};
+
+    job_submit(&batch, proc, data, count);
+    job_wait(&batch, 0);
+}
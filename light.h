@@ -0,0 +1,286 @@
+
+// Tile lightmap.
+//
+// Every tile holds a light level in [0, LIGHT_MAX]. Emitters (tile types and entities) set the level of their own tile
+// and light floods outwards, losing one level per tile, through everything that isn't a wall. Walls are lit by their
+// neighbours but stop the flood (unless they emit themselves).
+// Only what changed is redone: a changed tile first has the light that went through it removed (everything that got
+// dimmer than it along the way), then the edges of the removed area and any emitters inside it are flooded again.
+// Levels are flooded brightest first, so a tile is settled the first time it is reached.
+
+#define LIGHT_MAX           (15)
+#define LIGHT_LEVEL_COUNT   (LIGHT_MAX + 1)
+#define LIGHT_AMBIENT       (0.15f)
+#define LIGHT_TILE_COUNT    (MAP_SIZE * MAP_SIZE)
+#define LIGHT_NODE_MAX      (2 * LIGHT_TILE_COUNT)
+
+typedef struct light_remove_t {
+    u32         index;
+    u32         level;
+} light_remove_t;
+
+static u8               light_level[LIGHT_TILE_COUNT];
+static u8               light_source[LIGHT_TILE_COUNT];
+static u8               light_entity[LIGHT_TILE_COUNT];
+static u8               light_queued[LIGHT_TILE_COUNT];
+
+// brightest first flood queue, one linked stack per level:
+static u32              light_bucket[LIGHT_LEVEL_COUNT];
+static u32              light_node_count;
+static u32              light_node_index[LIGHT_NODE_MAX];
+static u32              light_node_next[LIGHT_NODE_MAX];
+
+static u32              light_remove_count;
+static light_remove_t   light_remove_array[LIGHT_TILE_COUNT];
+
+// tiles lit by entities this tick and the last:
+static u32              light_entity_count;
+static u32              light_entity_array[ENTITY_MAX];
+static u32              light_prev_count;
+static u32              light_prev_array[ENTITY_MAX];
+
+static b32              light_rebuild;
+static u32              light_map_version;
+
+// rgb multiplier for each level:
+static u32              light_color_table[LIGHT_LEVEL_COUNT];
+
+static void light_init(void) {
+    vec3_t tint = { 1.0f, 0.8f, 0.4f };
+
+    for (u32 i = 0; i < LIGHT_LEVEL_COUNT; ++i) {
+        f32 t = LIGHT_AMBIENT + (1.0f - LIGHT_AMBIENT) * i / LIGHT_MAX;
+
+        light_color_table[i] = pack_color_f32(t * (tint.x + (1 - tint.x) * LIGHT_AMBIENT),
+                                              t * (tint.y + (1 - tint.y) * LIGHT_AMBIENT),
+                                              t * (tint.z + (1 - tint.z) * LIGHT_AMBIENT), 1);
+    }
+
+    memset(light_entity, 0, sizeof (light_entity));
+
+    light_entity_count  = 0;
+    light_rebuild       = true;
+}
+
+static u32 light_get(i32 x, i32 y) {
+    if (OFF_MAP(x, y)) return 0;
+    return light_level[y * MAP_SIZE + x];
+}
+
+// multiplies a packed color by a light level:
+static u32 light_shade(u32 color, u32 level) {
+    u32 light   = light_color_table[level];
+    u32 result  = color & 0xff000000;
+
+    for (u32 shift = 0; shift < 24; shift += 8) {
+        u32 a = (color >> shift) & 0xff;
+        u32 b = (light >> shift) & 0xff;
+
+        result |= ((a * b + 127) / 255) << shift;
+    }
+
+    return result;
+}
+
+static b32 light_propagates(const map_t* map, u32 index) {
+    return light_source[index] > 0 || tile_is_traversable(&map->tiles[map_index(index % MAP_SIZE, index / MAP_SIZE)]);
+}
+
+static u32 light_tile_source(const map_t* map, u32 index) {
+    const tile_t* tile = &map->tiles[map_index(index % MAP_SIZE, index / MAP_SIZE)];
+    return MAX(tile_get_info(tile)->light, light_entity[index]);
+}
+
+static u32 light_neighbours(u32* out, u32 index) {
+    i32 x       = index % MAP_SIZE;
+    i32 y       = index / MAP_SIZE;
+    u32 count   = 0;
+
+    if (x > 0)              out[count++] = index - 1;
+    if (x < MAP_SIZE - 1)   out[count++] = index + 1;
+    if (y > 0)              out[count++] = index - MAP_SIZE;
+    if (y < MAP_SIZE - 1)   out[count++] = index + MAP_SIZE;
+
+    return count;
+}
+
+static void light_push(u32 index, u32 level) {
+    if (light_queued[index] == level) return;
+
+    if (light_node_count >= LIGHT_NODE_MAX) {
+        light_rebuild = true;
+        return;
+    }
+
+    u32 node = light_node_count++;
+
+    light_node_index[node]  = index;
+    light_node_next[node]   = light_bucket[level];
+    light_bucket[level]     = node + 1;
+    light_queued[index]     = level;
+}
+
+static void light_flood(const map_t* map) {
+    for (u32 level = LIGHT_MAX; level > 0; --level) {
+        while (light_bucket[level]) {
+            u32 node    = light_bucket[level] - 1;
+            u32 index   = light_node_index[node];
+
+            light_bucket[level] = light_node_next[node];
+
+            if (light_queued[index] == level) light_queued[index] = 0;
+
+            if (light_level[index] != level || level == 1) continue;
+            if (!light_propagates(map, index)) continue;
+
+            u32 neighbours[4];
+            u32 count = light_neighbours(neighbours, index);
+
+            for (u32 i = 0; i < count; ++i) {
+                u32 next = neighbours[i];
+
+                if (light_level[next] < level - 1) {
+                    light_level[next] = level - 1;
+                    light_push(next, level - 1);
+                }
+            }
+        }
+    }
+
+    light_node_count = 0;
+}
+
+// takes away all light that passed through 'index' and queues the edges of the dark area for flooding:
+static void light_remove(const map_t* map, u32 start) {
+    light_remove_count = 0;
+    light_remove_array[light_remove_count++] = (light_remove_t) { start, light_level[start] };
+    light_level[start] = 0;
+
+    for (u32 r = 0; r < light_remove_count; ++r) {
+        light_remove_t  item    = light_remove_array[r];
+        u32             index   = item.index;
+
+        // the first tile always spreads, it may have stopped being a wall:
+        if (index != start && !light_propagates(map, index)) continue;
+
+        u32 neighbours[4];
+        u32 count = light_neighbours(neighbours, index);
+
+        for (u32 i = 0; i < count; ++i) {
+            u32 next    = neighbours[i];
+            u32 level   = light_level[next];
+
+            if (level == 0) continue;
+
+            if (level < item.level) {
+                light_level[next] = 0;
+                light_remove_array[light_remove_count++] = (light_remove_t) { next, level };
+            } else {
+                light_push(next, level);
+            }
+        }
+    }
+
+    // emitters that got caught in the dark area light themselves again:
+    for (u32 r = 0; r < light_remove_count; ++r) {
+        u32 index = light_remove_array[r].index;
+
+        if (light_source[index]) {
+            light_level[index] = light_source[index];
+            light_push(index, light_source[index]);
+        }
+    }
+}
+
+static void light_update_tile(const map_t* map, u32 index) {
+    light_source[index] = light_tile_source(map, index);
+    light_remove(map, index);
+}
+
+static void light_build(const map_t* map) {
+    memset(light_level,     0, sizeof (light_level));
+    memset(light_queued,    0, sizeof (light_queued));
+    memset(light_bucket,    0, sizeof (light_bucket));
+
+    light_node_count    = 0;
+    light_rebuild       = false;
+
+    for (u32 i = 0; i < LIGHT_TILE_COUNT; ++i) {
+        light_source[i] = light_tile_source(map, i);
+
+        if (light_source[i]) {
+            light_level[i] = light_source[i];
+            light_push(i, light_source[i]);
+        }
+    }
+
+    light_flood(map);
+}
+
+static void update_light(game_state_t* gs) {
+    map_t* map = &gs->map;
+
+    // take the entity emitters of last tick off the grid, keeping the list to compare against:
+    light_prev_count = light_entity_count;
+    memcpy(light_prev_array, light_entity_array, light_entity_count * sizeof (u32));
+
+    for (u32 i = 0; i < light_entity_count; ++i) {
+        light_entity[light_entity_array[i]] = 0;
+    }
+
+    light_entity_count = 0;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        const entity_t* e       = &gs->entity_array[i];
+        u32             level   = entity_get_info(e)->light;
+
+        if (!level || OFF_MAP((i32)e->pos.x, (i32)e->pos.y)) continue;
+
+        u32 index = (i32)e->pos.y * MAP_SIZE + (i32)e->pos.x;
+
+        if (!light_entity[index]) {
+            light_entity_array[light_entity_count++] = index;
+        }
+
+        light_entity[index] = MAX(light_entity[index], level);
+    }
+
+    // the map changed without us seeing every change (new map, or more changes than fit in the list):
+    if (map->change_overflow || map->version - light_map_version != map->change_count) {
+        light_rebuild = true;
+    }
+
+    light_map_version = map->version;
+
+    if (light_rebuild) {
+        light_build(map);
+        return;
+    }
+
+    for (u32 i = 0; i < map->change_count; ++i) {
+        vec2i_t pos = map->change_array[i];
+        light_update_tile(map, pos.y * MAP_SIZE + pos.x);
+    }
+
+    for (u32 i = 0; i < light_prev_count; ++i) {
+        u32 index = light_prev_array[i];
+
+        if (light_tile_source(map, index) != light_source[index]) {
+            light_update_tile(map, index);
+        }
+    }
+
+    for (u32 i = 0; i < light_entity_count; ++i) {
+        u32 index = light_entity_array[i];
+
+        if (light_tile_source(map, index) != light_source[index]) {
+            light_update_tile(map, index);
+        }
+    }
+
+    light_flood(map);
+
+    if (light_rebuild) {
+        light_build(map);
+    }
+}
@@ -18,8 +18,28 @@ static u32 rs = 0xdeadbeef;
 #include "particle.h"
 #include "camera.h"
 #include "game_state.h"
+#include "entity_grid.h"
 
+#include "thread.h"
+#include "job.h"
+#include "profile.h"
+#include "input.h"
+#include "simd.h"
+
+#include "map_gen.h"
+
+#include "command.h"
 #include "path_finder.h"
+#include "path_service.h"
+#include "group.h"
+#include "visibility.h"
+#include "light.h"
+#include "minimap.h"
+#include "command_flush.h"
+#include "colony.h"
+#include "pheromone.h"
+#include "save.h"
+#include "render_view.h"
 
 static memory_arena_t   ma              = {0};
 static game_state_t*    game_state      = NULL;
@@ -31,6 +51,7 @@ static vec3_t           mouse_position  = { 0.5 * MAP_SIZE, 0.5 * MAP_SIZE };
 
 #include "init.c"
 #include "update.c"
+#include "pipeline.h"
 #include "render.c"
 
 static u8 memory[GB];
@@ -39,27 +60,50 @@ int main(void) {
     ma              = ma_create(memory, ARRAY_COUNT(memory));
     game_state      = ma_type(&ma, game_state_t);
 
+    job_init();
+    save_init();
+    map_gen_init();
+    path_service_init();
+    group_init();
+    vis_init();
+    light_init();
+    minimap_init();
+    colony_init();
+    pheromone_init();
+
     platform_init("Game Off 2021", 1200, 800, 0);
     render_init();
 
     game_state_t* gs = game_state;
     init_game(gs);
 
+    pipeline_init(gs);
+
     while (!platform.close) {
         f32 dt = platform.time.delta;
 
         if (platform.keyboard.pressed[KEY_ESCAPE])  { platform.close = true; }
         if (platform.keyboard.pressed[KEY_F1])      { platform.fullscreen = !platform.fullscreen; }
+        if (platform.keyboard.pressed[KEY_L])       { use_lightmap = !use_lightmap; }
+        if (platform.keyboard.pressed[KEY_M])       { show_minimap = !show_minimap; }
+
+        // the simulation is idle from here until 'pipeline_start':
+        pipeline_wait();
+
+        if (platform.keyboard.pressed[KEY_P])       { use_pipeline = !use_pipeline; }
+        if (platform.keyboard.pressed[KEY_F9])      { load_game(gs); }
 
         if (platform.keyboard.pressed[KEY_T]) {
             printf("%u\n", gs->order_tool);
         }
 
-        update_game(gs, dt);
+        input_t in;
+        input_capture(&in, mouse_position);
+        pipeline_start(&in, dt);
 
         defer (sr_begin_frame(), sr_end_frame()) {
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            render_game(gs);
+            render_game(pipeline_front_view());
         }
 
         mouse_position = gl_get_world_position(platform.mouse.pos.x, platform.mouse.pos.y, projection, view);
@@ -0,0 +1,367 @@
+
+// Procedural map generation.
+//
+// Every tile is a pure function of (seed, x, y): the noise is built from a counter based hash instead of a running rng,
+// so any chunk can be generated on its own, in any order, on any thread, and always comes out the same.
+// A map is generated by running the stage list over each MAP_GEN_CHUNK x MAP_GEN_CHUNK chunk. The inner loops work on
+// whole rows of plain integers/floats without branches so the compiler can vectorize them.
+// The compiler won't vectorize the 32 bit multiplies of the hash or the table lookups of the noise without /arch, so
+// those two rows have AVX2 versions, picked in 'map_gen_init' the same way as the pheromone rows (see simd.h).
+
+#define MAP_GEN_CHUNK           (32)
+#define MAP_GEN_SHIFT_COUNT     (6) // noise lattices up to one cell per chunk
+#define MAP_GEN_WEIGHT_COUNT    (MAP_GEN_CHUNK + 8)
+
+// the inner loops that are worth a cpu specific version:
+typedef void map_gen_hash_row_t(u32* out, u32 seed, i32 x, i32 y, u32 stream, u32 count);
+typedef void map_gen_lerp_row_t(f32* out, const f32* column, const f32* weight, i32 origin, u32 shift);
+
+typedef struct map_gen_rows_t {
+    map_gen_hash_row_t*     hash;
+    map_gen_lerp_row_t*     lerp;
+} map_gen_rows_t;
+
+typedef struct map_gen_desc_t {
+    u32                     seed;
+    const map_gen_rows_t*   rows; // NULL for the ones picked in 'map_gen_init'
+
+    vec2_t                  spawn;
+    f32                     spawn_radius;
+} map_gen_desc_t;
+
+typedef struct map_gen_chunk_t {
+    const map_gen_desc_t*   desc;
+    const map_gen_rows_t*   rows;
+
+    // smoothstep weights across a lattice cell, per shift, repeated every cell so 8 in a row can be read from anywhere
+    // inside the first one:
+    f32                     weight[MAP_GEN_SHIFT_COUNT][MAP_GEN_WEIGHT_COUNT];
+
+    i32                     x;
+    i32                     y;
+
+    tile_type_t             tiles[MAP_GEN_CHUNK][MAP_GEN_CHUNK];
+} map_gen_chunk_t;
+
+typedef void map_gen_stage_t(map_gen_chunk_t* chunk);
+
+static u32 map_gen_hash(u32 seed, i32 x, i32 y, u32 stream) {
+    u32 h = seed + (u32)x * 0x8da6b343u + (u32)y * 0xd8163841u + stream * 0xcb1ab31fu;
+
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+
+    return h;
+}
+
+static f32 map_gen_hash_f32(u32 seed, i32 x, i32 y, u32 stream) {
+    return (map_gen_hash(seed, x, y, stream) >> 8) * (1.0f / 16777216.0f);
+}
+
+// 'count' hashes along a row, starting at (x, y):
+static void map_gen_hash_row_scalar(u32* out, u32 seed, i32 x, i32 y, u32 stream, u32 count) {
+    for (u32 i = 0; i < count; ++i) {
+        out[i] = map_gen_hash(seed, x + i, y, stream);
+    }
+}
+
+// a chunk row of noise from the lattice 'column's, 'origin' is the first tile relative to column[0]:
+static void map_gen_lerp_row_scalar(f32* out, const f32* column, const f32* weight, i32 origin, u32 shift) {
+    i32 mask = (1 << shift) - 1;
+
+    for (i32 i = 0; i < MAP_GEN_CHUNK; ++i) {
+        i32 cell    = (origin + i) >> shift;
+        f32 left    = column[cell + 0];
+        f32 right   = column[cell + 1];
+
+        out[i] = left + (right - left) * weight[(origin + i) & mask];
+    }
+}
+
+static const map_gen_rows_t map_gen_rows_scalar = {
+    map_gen_hash_row_scalar,
+    map_gen_lerp_row_scalar,
+};
+
+#if defined(SIMD_X86)
+
+SIMD_AVX2 static __m256i map_gen_hash_avx2(__m256i base, __m256i x) {
+    __m256i h = _mm256_add_epi32(base, _mm256_mullo_epi32(x, _mm256_set1_epi32((i32)0x8da6b343u)));
+
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x7feb352d));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((i32)0x846ca68bu));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+
+    return h;
+}
+
+SIMD_AVX2 static void map_gen_hash_row_avx2(u32* out, u32 seed, i32 x, i32 y, u32 stream, u32 count) {
+    __m256i base    = _mm256_set1_epi32(seed + (u32)y * 0xd8163841u + stream * 0xcb1ab31fu);
+    __m256i lane    = _mm256_add_epi32(_mm256_set1_epi32(x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i step    = _mm256_set1_epi32(8);
+    u32     i       = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i*)&out[i], map_gen_hash_avx2(base, lane));
+
+        lane = _mm256_add_epi32(lane, step);
+    }
+
+    // the last few through a whole vector as well, the noise rows mostly ask for counts that aren't a multiple of 8:
+    if (i < count) {
+        u32 tail[8];
+
+        _mm256_storeu_si256((__m256i*)tail, map_gen_hash_avx2(base, lane));
+        memcpy(&out[i], tail, (count - i) * sizeof (u32));
+    }
+}
+
+// each group of 8 tiles spans at most 8 lattice columns for shift >= 1, so one unaligned load of the columns and a
+// permute per side replace the lookups:
+SIMD_AVX2 static void map_gen_lerp_row_avx2(f32* out, const f32* column, const f32* weight, i32 origin, u32 shift) {
+    if (shift == 0) {
+        map_gen_lerp_row_scalar(out, column, weight, origin, shift);
+        return;
+    }
+
+    __m128i count   = _mm_cvtsi32_si128(shift);
+    __m256i lane    = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i one     = _mm256_set1_epi32(1);
+    i32     mask    = (1 << shift) - 1;
+
+    for (i32 i = 0; i < MAP_GEN_CHUNK; i += 8) {
+        i32     first   = (origin + i) >> shift;
+        __m256i tile    = _mm256_add_epi32(_mm256_set1_epi32(origin + i), lane);
+        __m256i cell    = _mm256_sub_epi32(_mm256_sra_epi32(tile, count), _mm256_set1_epi32(first));
+        __m256  window  = _mm256_loadu_ps(column + first);
+
+        __m256  left    = _mm256_permutevar8x32_ps(window, cell);
+        __m256  right   = _mm256_permutevar8x32_ps(window, _mm256_add_epi32(cell, one));
+        __m256  t       = _mm256_loadu_ps(weight + ((origin + i) & mask));
+
+        // a separate multiply and add, the same two roundings as the scalar version:
+        _mm256_storeu_ps(&out[i], _mm256_add_ps(left, _mm256_mul_ps(_mm256_sub_ps(right, left), t)));
+    }
+}
+
+static const map_gen_rows_t map_gen_rows_avx2 = {
+    map_gen_hash_row_avx2,
+    map_gen_lerp_row_avx2,
+};
+
+#endif
+
+static const map_gen_rows_t* map_gen_best_rows(void) {
+#if defined(SIMD_X86)
+    if (simd_has_avx2()) return &map_gen_rows_avx2;
+#endif
+    return &map_gen_rows_scalar;
+}
+
+static const map_gen_rows_t* map_gen_rows = &map_gen_rows_scalar;
+
+static void map_gen_init(void) {
+    map_gen_rows = map_gen_best_rows();
+}
+
+// value noise with a lattice every 2^shift tiles, one row of a chunk at a time.
+// the lattice columns the row touches are hashed and blended vertically up front, the per-tile part is a single lerp:
+static void map_gen_noise_row(f32* out, const map_gen_chunk_t* chunk, i32 x, i32 y, u32 shift, u32 stream) {
+    const f32* weight = chunk->weight[shift];
+
+    i32 cell_x      = x >> shift;
+    i32 cell_y      = y >> shift;
+    i32 cell_count  = ((x + MAP_GEN_CHUNK - 1) >> shift) - cell_x + 2;
+    f32 ty          = weight[y - (cell_y << shift)];
+
+    u32 top[MAP_GEN_CHUNK + 2];
+    u32 bottom[MAP_GEN_CHUNK + 2];
+    f32 column[MAP_GEN_CHUNK + 2];
+
+    chunk->rows->hash(top,    chunk->desc->seed, cell_x, cell_y + 0, stream, cell_count);
+    chunk->rows->hash(bottom, chunk->desc->seed, cell_x, cell_y + 1, stream, cell_count);
+
+    for (i32 i = 0; i < cell_count; ++i) {
+        f32 a = (top[i]    >> 8) * (1.0f / 16777216.0f);
+        f32 b = (bottom[i] >> 8) * (1.0f / 16777216.0f);
+
+        column[i] = a + (b - a) * ty;
+    }
+
+    chunk->rows->lerp(out, column, weight, x - (cell_x << shift), shift);
+}
+
+// one hash per tile of row 'y' of the chunk, compared against a fraction of the full range:
+static void map_gen_speck_row(b32* out, const map_gen_chunk_t* chunk, i32 y, u32 stream, f32 chance) {
+    u32 threshold = (u32)(chance * 4294967295.0f);
+    u32 hash[MAP_GEN_CHUNK];
+
+    chunk->rows->hash(hash, chunk->desc->seed, chunk->x, chunk->y + y, stream, MAP_GEN_CHUNK);
+
+    for (i32 i = 0; i < MAP_GEN_CHUNK; ++i) {
+        out[i] = hash[i] < threshold;
+    }
+}
+
+// three octaves of row 'y' of the chunk, each shifted by a few tiles so the lattices don't line up, roughly in [0, 1]:
+static void map_gen_fractal_row(f32* out, const map_gen_chunk_t* chunk, i32 y, u32 shift, u32 stream) {
+    f32 octave[MAP_GEN_CHUNK];
+
+    for (i32 i = 0; i < MAP_GEN_CHUNK; ++i) {
+        out[i] = 0;
+    }
+
+    f32 weight  = 4.0f / 7.0f;
+
+    for (u32 n = 0; n < 3; ++n) {
+        i32 offset = 5 * n;
+
+        map_gen_noise_row(octave, chunk, chunk->x + offset, chunk->y + y + offset, shift - n, stream + n);
+
+        for (i32 i = 0; i < MAP_GEN_CHUNK; ++i) {
+            out[i] += weight * octave[i];
+        }
+
+        weight *= 0.5f;
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// stages:
+
+static void map_gen_stage_rock(map_gen_chunk_t* chunk) {
+    for (i32 y = 0; y < MAP_GEN_CHUNK; ++y) {
+        for (i32 x = 0; x < MAP_GEN_CHUNK; ++x) {
+            chunk->tiles[y][x] = TILE_TYPE_ROCK;
+        }
+    }
+}
+
+// thin ridges of copper along the zero crossings of a noise field, plus a sprinkle of single tiles:
+static void map_gen_stage_ore_veins(map_gen_chunk_t* chunk) {
+    for (i32 y = 0; y < MAP_GEN_CHUNK; ++y) {
+        f32 noise[MAP_GEN_CHUNK];
+        b32 speck[MAP_GEN_CHUNK];
+
+        map_gen_fractal_row(noise, chunk, y, 4, 100);
+        map_gen_speck_row(speck, chunk, y, 110, 0.03f);
+
+        for (i32 x = 0; x < MAP_GEN_CHUNK; ++x) {
+            f32 ridge   = 1.0f - fabsf(2.0f * noise[x] - 1.0f);
+            b32 is_ore  = (ridge > 0.95f) | speck[x];
+
+            chunk->tiles[y][x] = is_ore? TILE_TYPE_COPPER : chunk->tiles[y][x];
+        }
+    }
+}
+
+static void map_gen_stage_caves(map_gen_chunk_t* chunk) {
+    for (i32 y = 0; y < MAP_GEN_CHUNK; ++y) {
+        f32 noise[MAP_GEN_CHUNK];
+        b32 speck[MAP_GEN_CHUNK];
+
+        map_gen_fractal_row(noise, chunk, y, 4, 200);
+        map_gen_speck_row(speck, chunk, y, 210, 0.04f);
+
+        for (i32 x = 0; x < MAP_GEN_CHUNK; ++x) {
+            b32 is_cave = (noise[x] > 0.66f) | speck[x];
+
+            chunk->tiles[y][x] = is_cave? TILE_TYPE_DIRT : chunk->tiles[y][x];
+        }
+    }
+}
+
+static void map_gen_stage_spawn(map_gen_chunk_t* chunk) {
+    const map_gen_desc_t* desc = chunk->desc;
+
+    f32 rad_sq = desc->spawn_radius * desc->spawn_radius;
+
+    for (i32 y = 0; y < MAP_GEN_CHUNK; ++y) {
+        f32 dy = chunk->y + y + 0.5f - desc->spawn.y;
+
+        for (i32 x = 0; x < MAP_GEN_CHUNK; ++x) {
+            f32 dx = chunk->x + x + 0.5f - desc->spawn.x;
+
+            chunk->tiles[y][x] = (dx * dx + dy * dy < rad_sq)? TILE_TYPE_DIRT : chunk->tiles[y][x];
+        }
+    }
+}
+
+static map_gen_stage_t* map_gen_stage_array[] = {
+    map_gen_stage_rock,
+    map_gen_stage_ore_veins,
+    map_gen_stage_caves,
+    map_gen_stage_spawn,
+};
+
+// chunk_x, chunk_y in chunks, works anywhere in the (infinite) world:
+static void map_gen_chunk(map_gen_chunk_t* chunk, const map_gen_desc_t* desc, i32 chunk_x, i32 chunk_y) {
+    chunk->desc     = desc;
+    chunk->rows     = desc->rows? desc->rows : map_gen_rows;
+    chunk->x        = chunk_x * MAP_GEN_CHUNK;
+    chunk->y        = chunk_y * MAP_GEN_CHUNK;
+
+    for (u32 shift = 0; shift < MAP_GEN_SHIFT_COUNT; ++shift) {
+        i32 mask    = (1 << shift) - 1;
+        f32 scale   = 1.0f / (1 << shift);
+
+        for (i32 i = 0; i < MAP_GEN_WEIGHT_COUNT; ++i) {
+            f32 t = ((i & mask) + 0.5f) * scale;
+            chunk->weight[shift][i] = t * t * (3 - 2 * t);
+        }
+    }
+
+    for (u32 i = 0; i < ARRAY_COUNT(map_gen_stage_array); ++i) {
+        map_gen_stage_array[i](chunk);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// whole areas, chunks are spread over the job workers:
+
+typedef struct map_gen_area_t {
+    const map_gen_desc_t*   desc;
+
+    i32                     width;
+    i32                     height;
+    i32                     chunk_count_x;
+
+    tile_type_t*            tiles;
+} map_gen_area_t;
+
+static void map_gen_area_job(void* data, u32 index, u32 thread_index) {
+    map_gen_area_t* area    = data;
+    i32             chunk_x = index % area->chunk_count_x;
+    i32             chunk_y = index / area->chunk_count_x;
+
+    map_gen_chunk_t chunk;
+    map_gen_chunk(&chunk, area->desc, chunk_x, chunk_y);
+
+    for (i32 y = 0; y < MAP_GEN_CHUNK; ++y) {
+        i32 ty = chunk.y + y;
+        if (ty >= area->height) break;
+
+        i32 count = MIN(MAP_GEN_CHUNK, area->width - chunk.x);
+        memcpy(&area->tiles[ty * area->width + chunk.x], chunk.tiles[y], count * sizeof (tile_type_t));
+    }
+}
+
+// fills 'tiles' (width * height, row major) with the area starting at the world origin:
+static void map_gen_area(const map_gen_desc_t* desc, i32 width, i32 height, tile_type_t* tiles) {
+    map_gen_area_t area = {
+        .desc           = desc,
+        .width          = width,
+        .height         = height,
+        .chunk_count_x  = (width  + MAP_GEN_CHUNK - 1) / MAP_GEN_CHUNK,
+        .tiles          = tiles,
+    };
+
+    i32 chunk_count_y = (height + MAP_GEN_CHUNK - 1) / MAP_GEN_CHUNK;
+
+    job_run(map_gen_area_job, &area, area.chunk_count_x * chunk_count_y);
+}
@@ -0,0 +1,163 @@
+
+// Minimap.
+//
+// One pixel per tile, drawn on the cpu from the tile colours: explored tiles only, floors darker than walls, and a dot
+// in the middle of every MINIMAP_CELL x MINIMAP_CELL cell that has units or visible ants in it, brighter the more
+// there are. It is drawn in full once. After that only the tiles that changed type or were just explored, and the
+// cells whose dot changed, are drawn again, and the MINIMAP_BLOCK x MINIMAP_BLOCK blocks they fall in are flagged so
+// the renderer can upload just those.
+
+#define MINIMAP_SIZE        (MAP_SIZE)
+#define MINIMAP_BLOCK       (16)
+#define MINIMAP_BLOCK_ROW   (MINIMAP_SIZE / MINIMAP_BLOCK)
+#define MINIMAP_BLOCK_COUNT (MINIMAP_BLOCK_ROW * MINIMAP_BLOCK_ROW)
+#define MINIMAP_CELL        (4)
+#define MINIMAP_CELL_ROW    (MINIMAP_SIZE / MINIMAP_CELL)
+#define MINIMAP_CELL_COUNT  (MINIMAP_CELL_ROW * MINIMAP_CELL_ROW)
+
+#define MINIMAP_UNEXPLORED  (0xff000000)
+#define MINIMAP_UNIT_COLOR  (0xff44ff44)
+#define MINIMAP_ANT_COLOR   (0xff4444ff)
+
+// who is in a cell, times 4, plus how crowded it is (1 to 3), 0 for nobody:
+typedef u8 minimap_dot_t;
+enum {
+    MINIMAP_DOT_ANT     = 1 << 2,
+    MINIMAP_DOT_UNIT    = 2 << 2,
+};
+
+// row major, y up:
+static u32              minimap_pixels[MINIMAP_SIZE * MINIMAP_SIZE];
+static minimap_dot_t    minimap_dot[MINIMAP_CELL_COUNT];
+static b32              minimap_dirty[MINIMAP_BLOCK_COUNT];
+
+static b32              minimap_rebuild;
+static u32              minimap_map_version;
+
+static void minimap_init(void) {
+    minimap_rebuild = true;
+}
+
+// 'amount' out of 256:
+static u32 minimap_blend(u32 a, u32 b, u32 amount) {
+    u32 rb = ((a & 0x00ff00ff) * (256 - amount) + (b & 0x00ff00ff) * amount) >> 8;
+    u32 g  = ((a & 0x0000ff00) * (256 - amount) + (b & 0x0000ff00) * amount) >> 8;
+
+    return 0xff000000 | (rb & 0x00ff00ff) | (g & 0x0000ff00);
+}
+
+// what the pixel for tile (x, y) should be, everything else has to agree with this:
+static u32 minimap_pixel(const map_t* map, const minimap_dot_t* dots, i32 x, i32 y) {
+    if (!vis_is_explored(x, y)) return MINIMAP_UNEXPLORED;
+
+    const tile_info_t*  info    = tile_get_info(&map->tiles[map_index(x, y)]);
+    u32                 color   = info->is_wall? info->color : minimap_blend(info->color, 0xff000000, 128);
+
+    // the dot covers the middle 2 x 2 pixels of its cell:
+    u32 cx = x % MINIMAP_CELL;
+    u32 cy = y % MINIMAP_CELL;
+
+    if ((cx == 1 || cx == 2) && (cy == 1 || cy == 2)) {
+        minimap_dot_t dot = dots[(y / MINIMAP_CELL) * MINIMAP_CELL_ROW + x / MINIMAP_CELL];
+
+        if (dot) {
+            color = minimap_blend(color, (dot & MINIMAP_DOT_UNIT)? MINIMAP_UNIT_COLOR : MINIMAP_ANT_COLOR, 64 + 64 * (dot & 3));
+        }
+    }
+
+    return color;
+}
+
+// the density grid, downsampled to cells:
+static void minimap_build_dots(minimap_dot_t* dots, const game_state_t* gs) {
+    static u16 unit_count[MINIMAP_CELL_COUNT];
+    static u16 ant_count[MINIMAP_CELL_COUNT];
+
+    memset(unit_count,  0, sizeof (unit_count));
+    memset(ant_count,   0, sizeof (ant_count));
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        const entity_t* e = &gs->entity_array[i];
+        i32             x = (i32)e->pos.x;
+        i32             y = (i32)e->pos.y;
+
+        if (OFF_MAP(x, y)) continue;
+
+        u32 cell = (y / MINIMAP_CELL) * MINIMAP_CELL_ROW + x / MINIMAP_CELL;
+
+        if (entity_is_unit(e)) {
+            unit_count[cell]++;
+        } else if (e->type == ENTITY_TYPE_ANT && vis_is_visible(x, y)) {
+            ant_count[cell]++;
+        }
+    }
+
+    for (u32 i = 0; i < MINIMAP_CELL_COUNT; ++i) {
+        u32 count = unit_count[i]? unit_count[i] : ant_count[i];
+        u32 level = count >= 4? 3 : count >= 2? 2 : count;
+
+        dots[i] = level? ((unit_count[i]? MINIMAP_DOT_UNIT : MINIMAP_DOT_ANT) | level) : 0;
+    }
+}
+
+// the whole thing from scratch, also what the incremental updates are checked against:
+static void minimap_build(u32* pixels, minimap_dot_t* dots, const game_state_t* gs) {
+    minimap_build_dots(dots, gs);
+
+    for (i32 y = 0; y < MINIMAP_SIZE; ++y) {
+        for (i32 x = 0; x < MINIMAP_SIZE; ++x) {
+            pixels[y * MINIMAP_SIZE + x] = minimap_pixel(&gs->map, dots, x, y);
+        }
+    }
+}
+
+static void minimap_draw(const map_t* map, i32 x, i32 y) {
+    minimap_pixels[y * MINIMAP_SIZE + x] = minimap_pixel(map, minimap_dot, x, y);
+    minimap_dirty[(y / MINIMAP_BLOCK) * MINIMAP_BLOCK_ROW + x / MINIMAP_BLOCK] = true;
+}
+
+// after visibility, so the explored list is this tick's:
+static void update_minimap(game_state_t* gs) {
+    static minimap_dot_t next_dot[MINIMAP_CELL_COUNT];
+
+    map_t* map = &gs->map;
+
+    if (minimap_rebuild || map->change_overflow || vis_explored_overflow || map->version - minimap_map_version != map->change_count) {
+        minimap_build(minimap_pixels, minimap_dot, gs);
+
+        for (u32 i = 0; i < MINIMAP_BLOCK_COUNT; ++i) {
+            minimap_dirty[i] = true;
+        }
+
+        minimap_rebuild     = false;
+        minimap_map_version = map->version;
+
+        return;
+    }
+
+    minimap_map_version = map->version;
+
+    for (u32 i = 0; i < map->change_count; ++i) {
+        minimap_draw(map, map->change_array[i].x, map->change_array[i].y);
+    }
+
+    for (u32 i = 0; i < vis_explored_count; ++i) {
+        minimap_draw(map, vis_explored_array[i].x, vis_explored_array[i].y);
+    }
+
+    minimap_build_dots(next_dot, gs);
+
+    for (u32 i = 0; i < MINIMAP_CELL_COUNT; ++i) {
+        if (next_dot[i] == minimap_dot[i]) continue;
+
+        minimap_dot[i] = next_dot[i];
+
+        i32 x = (i % MINIMAP_CELL_ROW) * MINIMAP_CELL;
+        i32 y = (i / MINIMAP_CELL_ROW) * MINIMAP_CELL;
+
+        minimap_draw(map, x + 1, y + 1);
+        minimap_draw(map, x + 2, y + 1);
+        minimap_draw(map, x + 1, y + 2);
+        minimap_draw(map, x + 2, y + 2);
+    }
+}
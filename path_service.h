@@ -0,0 +1,873 @@
+
+// Asynchronous, cached path corridors.
+//
+// AI code owns a handle per requester and calls 'path_service_steer' every tick with where it is and where it wants to go.
+// When the target is in plain sight the entity just walks straight at it. Otherwise it follows a corridor of waypoints
+// computed with A* on the job workers (against a snapshot of the map) and string-pulled with line of sight checks.
+// A corridor is only searched again when a tile along it changes, when the target moves somewhere the corridor can't be
+// bent to reach, or when the entity is knocked off it. Identical requests made in the same tick are coalesced into one
+// search, and a new request or a release bumps the handle generation so stale results are dropped. Once PATH_SHARE_MIN or
+// more different starts head for the same goal in a tick, one breadth first search out from the goal answers all of them.
+// A search in flight is never thrown away for a target that moved, it lands first and its last leg gets bent (or searched
+// again) from there, so a target changing tiles faster than a search takes still gets followed.
+// A search that finds nothing keeps the chunks it flooded, and the target is only tried again once a tile in or next to
+// one of them changes. Anything else can't connect the two.
+
+#define PATH_SLOT_MAX       (ENTITY_MAX)
+#define PATH_CORRIDOR_MAX   (32)
+#define PATH_JOB_HASH_SIZE  (4096)
+#define PATH_SHARE_MIN      (4)
+#define PATH_RAY_RADIUS     (0.2)
+#define PATH_ARRIVE_RADIUS  (0.1)
+
+#define PATH_REGION_SHIFT   (4)
+#define PATH_REGION_SIDE    (MAP_SIZE >> PATH_REGION_SHIFT)
+#define PATH_REGION_COUNT   (PATH_REGION_SIDE * PATH_REGION_SIDE)
+#define PATH_REGION_WORDS   (PATH_REGION_COUNT / 32)
+
+typedef struct path_corridor_t {
+    b32             found;
+    b32             complete;   // false if the path was longer than PATH_CORRIDOR_MAX waypoints
+
+    u32             waypoint_count;
+    vec2i_t         waypoint_array[PATH_CORRIDOR_MAX];
+
+    // if nothing was found, a bit per PATH_REGION_SHIFT sized chunk the search closed tiles in:
+    u32             region[PATH_REGION_WORDS];
+} path_corridor_t;
+
+typedef struct path_slot_t {
+    volatile u32    generation;
+
+    b32             in_use;
+    b32             pending;
+    b32             solved;
+
+    vec2i_t         goal;
+    u32             map_version;
+
+    // a request waiting for the next submit, only the newest one per slot counts:
+    b32             requested;
+    vec2i_t         request_start;
+
+    u32             waypoint_index;
+    path_corridor_t corridor;
+} path_slot_t;
+
+typedef struct path_request_t {
+    u32             handle;
+    u32             generation;
+
+    vec2i_t         start;
+    vec2i_t         goal;
+
+    u32             job_index;
+    u32             next_in_job;
+} path_request_t;
+
+typedef struct path_job_t {
+    vec2i_t         start;
+    vec2i_t         goal;
+    u32             first_request;
+    u32             next_in_task;
+
+    path_corridor_t corridor;
+} path_job_t;
+
+// every job heading for one goal tile, solved on the same worker:
+typedef struct path_task_t {
+    u32             first_job;
+    u32             job_count;
+} path_task_t;
+
+typedef struct path_scratch_t {
+    u32             id;
+    u64             expansion_count;
+
+    u32             region[PATH_REGION_WORDS];
+
+    // indexed with 'map_index', same layout as the map tiles:
+    u32             visited[MAP_SIZE * MAP_SIZE];
+    u32             closed[MAP_SIZE * MAP_SIZE];
+    u32             cost[MAP_SIZE * MAP_SIZE];
+    u32             score[MAP_SIZE * MAP_SIZE];
+    u32             heap_index[MAP_SIZE * MAP_SIZE];
+    u8              step[MAP_SIZE * MAP_SIZE];
+
+    u32             heap_count;
+    vec2i_t         heap[MAP_SIZE * MAP_SIZE];
+
+    u32             tile_count;
+    vec2i_t         tile_array[MAP_SIZE * MAP_SIZE];
+} path_scratch_t;
+
+static path_slot_t      path_slot_array[PATH_SLOT_MAX];
+static u32              path_free_count;
+static u32              path_free_array[PATH_SLOT_MAX];
+
+// owned by the workers while 'path_batch_active' is set:
+static b32              path_batch_active;
+static job_batch_t      path_batch;
+static u32              path_request_count;
+static path_request_t   path_request_array[PATH_SLOT_MAX];
+static u32              path_job_count;
+static path_job_t       path_job_array[PATH_SLOT_MAX];
+static u32              path_task_count;
+static path_task_t      path_task_array[PATH_SLOT_MAX];
+static u32              path_walkable_version;
+static u8               path_walkable[MAP_SIZE * MAP_SIZE];
+
+// map version of the last change in or next to each region chunk, read from the map change list:
+static b32              path_track_all;
+static u32              path_tracked_version;
+static u32              path_region_version[PATH_REGION_COUNT];
+
+static u32              path_job_hash_id;
+static u32              path_job_hash_stamp[PATH_JOB_HASH_SIZE];
+static u32              path_job_hash_index[PATH_JOB_HASH_SIZE];
+static u32              path_task_hash_stamp[PATH_JOB_HASH_SIZE];
+static u32              path_task_hash_index[PATH_JOB_HASH_SIZE];
+
+static path_scratch_t   path_scratch_array[JOB_THREAD_MAX];
+
+static vec2_t path_tile_center(vec2i_t tile) {
+    return v2(tile.x + 0.5, tile.y + 0.5);
+}
+
+static b32 path_tile_equal(vec2i_t a, vec2i_t b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+static u32 path_region_index(i32 x, i32 y) {
+    return (y >> PATH_REGION_SHIFT) * PATH_REGION_SIDE + (x >> PATH_REGION_SHIFT);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// line of sight:
+
+// grid traversal (Amanatides & Woo) that visits every tile the segment touches, including both tiles at exact corner crossings.
+// 'walkable' is the worker snapshot, or NULL to read the live map. The 'goal' tile counts as open so walls can be targeted.
+static b32 path_raycast(vec2_t a, vec2_t b, const map_t* map, const u8* walkable, vec2i_t goal) {
+    i32 x       = (i32)floorf(a.x);
+    i32 y       = (i32)floorf(a.y);
+    i32 end_x   = (i32)floorf(b.x);
+    i32 end_y   = (i32)floorf(b.y);
+
+    f32 dx      = b.x - a.x;
+    f32 dy      = b.y - a.y;
+
+    i32 step_x  = dx > 0? 1 : -1;
+    i32 step_y  = dy > 0? 1 : -1;
+
+    f32 delta_x = dx != 0? fabsf(1.0f / dx) : 1e30f;
+    f32 delta_y = dy != 0? fabsf(1.0f / dy) : 1e30f;
+
+    f32 max_x   = dx != 0? ((dx > 0? (x + 1 - a.x) : (a.x - x)) * delta_x) : 1e30f;
+    f32 max_y   = dy != 0? ((dy > 0? (y + 1 - a.y) : (a.y - y)) * delta_y) : 1e30f;
+
+#define PATH_IS_OPEN(tx, ty) \
+    (((tx) == goal.x && (ty) == goal.y) || (walkable? (!OFF_MAP(tx, ty) && walkable[map_index(tx, ty)]) : map_is_traversable(map, tx, ty)))
+
+    if (!PATH_IS_OPEN(x, y)) return false;
+
+    for (u32 n = abs(end_x - x) + abs(end_y - y); n > 0; --n) {
+        if (max_x < max_y) {
+            max_x += delta_x;
+            x += step_x;
+        } else if (max_y < max_x) {
+            max_y += delta_y;
+            y += step_y;
+        } else {
+            // passing exactly through a corner, don't squeeze between two diagonal walls:
+            if (!PATH_IS_OPEN(x + step_x, y) || !PATH_IS_OPEN(x, y + step_y)) return false;
+
+            max_x += delta_x;
+            max_y += delta_y;
+            x += step_x;
+            y += step_y;
+
+            if (n > 1) --n;
+        }
+
+        if (!PATH_IS_OPEN(x, y)) return false;
+    }
+
+#undef PATH_IS_OPEN
+
+    return true;
+}
+
+// two rays along the edges of the entity, so it doesn't try to shortcut around corners it would get stuck on:
+static b32 path_line_of_sight(vec2_t a, vec2_t b, const map_t* map, const u8* walkable, vec2i_t goal) {
+    vec2_t  dir     = v2_sub(b, a);
+    f32     len_sq  = v2_len_sq(dir);
+
+    if (len_sq < 0.0001) return path_raycast(a, b, map, walkable, goal);
+
+    vec2_t side = v2_scale(v2(-dir.y, dir.x), PATH_RAY_RADIUS / sqrtf(len_sq));
+
+    return path_raycast(v2_add(a, side), v2_add(b, side), map, walkable, goal) &&
+           path_raycast(v2_sub(a, side), v2_sub(b, side), map, walkable, goal);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// A* (runs on the job workers):
+
+static b32 path_heap_less(path_scratch_t* scratch, vec2i_t a, vec2i_t b) {
+    u32 index_a = map_index(a.x, a.y);
+    u32 index_b = map_index(b.x, b.y);
+    u32 score_a = scratch->score[index_a];
+    u32 score_b = scratch->score[index_b];
+
+    // prefer the node furthest along on ties, cuts down on expansions for open areas:
+    if (score_a == score_b) return scratch->cost[index_a] > scratch->cost[index_b];
+    return score_a < score_b;
+}
+
+static void path_heap_swap(path_scratch_t* scratch, u32 i, u32 j) {
+    vec2i_t a = scratch->heap[i];
+    vec2i_t b = scratch->heap[j];
+
+    scratch->heap[i] = b;
+    scratch->heap[j] = a;
+
+    scratch->heap_index[map_index(b.x, b.y)] = i;
+    scratch->heap_index[map_index(a.x, a.y)] = j;
+}
+
+static void path_heap_up(path_scratch_t* scratch, u32 i) {
+    while (i > 0) {
+        u32 parent = (i - 1) / 2;
+        if (!path_heap_less(scratch, scratch->heap[i], scratch->heap[parent])) break;
+
+        path_heap_swap(scratch, i, parent);
+        i = parent;
+    }
+}
+
+static void path_heap_push(path_scratch_t* scratch, vec2i_t pos) {
+    u32 i = scratch->heap_count++;
+
+    scratch->heap[i]                            = pos;
+    scratch->heap_index[map_index(pos.x, pos.y)] = i;
+
+    path_heap_up(scratch, i);
+}
+
+static vec2i_t path_heap_pop(path_scratch_t* scratch) {
+    vec2i_t result = scratch->heap[0];
+
+    path_heap_swap(scratch, 0, --scratch->heap_count);
+
+    u32 i = 0;
+    while (true) {
+        u32 left    = 2 * i + 1;
+        u32 right   = 2 * i + 2;
+        u32 best    = i;
+
+        if (left  < scratch->heap_count && path_heap_less(scratch, scratch->heap[left],  scratch->heap[best])) best = left;
+        if (right < scratch->heap_count && path_heap_less(scratch, scratch->heap[right], scratch->heap[best])) best = right;
+        if (best == i) break;
+
+        path_heap_swap(scratch, i, best);
+        i = best;
+    }
+
+    return result;
+}
+
+static u32 path_heuristic(vec2i_t a, vec2i_t b) {
+    return abs(a.x - b.x) + abs(a.y - b.y);
+}
+
+static b32 path_search(path_scratch_t* scratch, vec2i_t start, vec2i_t goal) {
+    scratch->id++;
+    scratch->heap_count = 0;
+
+    u32 start_index = map_index(start.x, start.y);
+
+    memset(scratch->region, 0, sizeof (scratch->region));
+
+    scratch->visited[start_index]   = scratch->id;
+    scratch->cost[start_index]      = 0;
+    scratch->score[start_index]     = path_heuristic(start, goal);
+
+    path_heap_push(scratch, start);
+
+    while (scratch->heap_count) {
+        vec2i_t current = path_heap_pop(scratch);
+
+        if (path_tile_equal(current, goal)) return true;
+
+        u32 current_index = map_index(current.x, current.y);
+
+        u32 region = path_region_index(current.x, current.y);
+
+        scratch->closed[current_index] = scratch->id;
+        scratch->region[region >> 5] |= 1u << (region & 31);
+        scratch->expansion_count++;
+
+        for (u32 i = 0; i < ARRAY_COUNT(path_dirs); ++i) {
+            vec2i_t next = v2i_add(current, path_dirs[i]);
+
+            if (OFF_MAP(next.x, next.y)) continue;
+
+            u32 index = map_index(next.x, next.y);
+
+            if (scratch->closed[index] == scratch->id) continue;
+            if (!path_walkable[index] && !path_tile_equal(next, goal)) continue;
+
+            u32 cost = scratch->cost[current_index] + 1;
+
+            if (scratch->visited[index] != scratch->id) {
+                scratch->visited[index]     = scratch->id;
+                scratch->cost[index]        = cost;
+                scratch->score[index]       = cost + path_heuristic(next, goal);
+                scratch->step[index]        = i;
+
+                path_heap_push(scratch, next);
+            } else if (cost < scratch->cost[index]) {
+                scratch->cost[index]        = cost;
+                scratch->score[index]       = cost + path_heuristic(next, goal);
+                scratch->step[index]        = i;
+
+                path_heap_up(scratch, scratch->heap_index[index]);
+            }
+        }
+    }
+
+    return false;
+}
+
+// one breadth first search out from 'goal' for all the starts marked in 'closed' (they count as open, the same way the
+// forward search leaves its start whatever it is), stops once 'remaining' of them are reached. The parents point
+// towards the goal:
+static void path_search_reverse(path_scratch_t* scratch, vec2i_t goal, u32 remaining) {
+    u32 begin   = 0;
+    u32 end     = 0;
+
+    memset(scratch->region, 0, sizeof (scratch->region));
+
+    u32 goal_index = map_index(goal.x, goal.y);
+
+    scratch->visited[goal_index]    = scratch->id;
+    scratch->heap[end++]            = goal;
+
+    if (scratch->closed[goal_index] == scratch->id) remaining--;
+
+    while (begin < end && remaining) {
+        vec2i_t current = scratch->heap[begin++];
+        u32     region  = path_region_index(current.x, current.y);
+
+        scratch->region[region >> 5] |= 1u << (region & 31);
+        scratch->expansion_count++;
+
+        for (u32 i = 0; i < ARRAY_COUNT(path_dirs); ++i) {
+            vec2i_t next = v2i_add(current, path_dirs[i]);
+
+            if (OFF_MAP(next.x, next.y)) continue;
+
+            u32 index       = map_index(next.x, next.y);
+            b32 is_start    = scratch->closed[index] == scratch->id;
+
+            if (scratch->visited[index] == scratch->id) continue;
+            if (!path_walkable[index] && !is_start) continue;
+
+            scratch->visited[index] = scratch->id;
+            scratch->step[index]    = i;
+
+            if (is_start) remaining--;
+            if (path_walkable[index]) scratch->heap[end++] = next;
+        }
+    }
+}
+
+// keeps only the tiles of 'tile_array' (goal first) where the straight line from the previous waypoint breaks:
+static void path_pull_corridor(path_scratch_t* scratch, path_corridor_t* corridor, vec2i_t start, vec2i_t goal) {
+    corridor->found             = true;
+    corridor->complete          = true;
+    corridor->waypoint_count    = 0;
+
+    vec2i_t anchor  = start;
+    i32     index   = scratch->tile_count - 1;
+
+    while (index >= 0) {
+        i32 furthest = index;
+
+        while (furthest > 0 && path_line_of_sight(path_tile_center(anchor), path_tile_center(scratch->tile_array[furthest - 1]), NULL, path_walkable, goal)) {
+            furthest--;
+        }
+
+        if (corridor->waypoint_count >= PATH_CORRIDOR_MAX) {
+            corridor->complete = false;
+            break;
+        }
+
+        anchor = scratch->tile_array[furthest];
+        corridor->waypoint_array[corridor->waypoint_count++] = anchor;
+
+        index = furthest - 1;
+    }
+}
+
+// forward search, walks the parents back from the goal:
+static void path_build_corridor(path_scratch_t* scratch, path_corridor_t* corridor, vec2i_t start, vec2i_t goal) {
+    scratch->tile_count = 0;
+
+    for (vec2i_t pos = goal; !path_tile_equal(pos, start);) {
+        scratch->tile_array[scratch->tile_count++] = pos;
+        pos = v2i_sub(pos, path_dirs[scratch->step[map_index(pos.x, pos.y)]]);
+    }
+
+    path_pull_corridor(scratch, corridor, start, goal);
+}
+
+// reverse search, the parents lead from the start to the goal so the tiles come out the other way round:
+static void path_build_corridor_reverse(path_scratch_t* scratch, path_corridor_t* corridor, vec2i_t start, vec2i_t goal) {
+    scratch->tile_count = 0;
+
+    for (vec2i_t pos = start; !path_tile_equal(pos, goal);) {
+        pos = v2i_sub(pos, path_dirs[scratch->step[map_index(pos.x, pos.y)]]);
+        scratch->tile_array[scratch->tile_count++] = pos;
+    }
+
+    for (i32 i = 0, j = (i32)scratch->tile_count - 1; i < j; ++i, --j) {
+        vec2i_t tile                = scratch->tile_array[i];
+        scratch->tile_array[i]      = scratch->tile_array[j];
+        scratch->tile_array[j]      = tile;
+    }
+
+    path_pull_corridor(scratch, corridor, start, goal);
+}
+
+static b32 path_request_is_stale(const path_request_t* request) {
+    return atomic_load_u32(&path_slot_array[request->handle - 1].generation) != request->generation;
+}
+
+// clears the result, false if every request on the job is stale:
+static b32 path_job_begin(path_job_t* job) {
+    b32 wanted = false;
+
+    for (u32 i = job->first_request; i; i = path_request_array[i - 1].next_in_job) {
+        wanted |= !path_request_is_stale(&path_request_array[i - 1]);
+    }
+
+    job->corridor.found             = false;
+    job->corridor.complete          = true;
+    job->corridor.waypoint_count    = 0;
+
+    return wanted;
+}
+
+static void path_solve_task(void* data, u32 index, u32 thread_index) {
+    path_scratch_t*     scratch = &path_scratch_array[thread_index];
+    const path_task_t*  task    = &path_task_array[index];
+
+    if (task->job_count < PATH_SHARE_MIN) {
+        for (u32 j = task->first_job; j; j = path_job_array[j - 1].next_in_task) {
+            path_job_t* job = &path_job_array[j - 1];
+
+            if (!path_job_begin(job)) continue;
+
+            if (path_search(scratch, job->start, job->goal)) {
+                path_build_corridor(scratch, &job->corridor, job->start, job->goal);
+            } else {
+                memcpy(job->corridor.region, scratch->region, sizeof (job->corridor.region));
+            }
+        }
+
+        return;
+    }
+
+    // the jobs all have the same goal and different starts:
+    vec2i_t goal        = path_job_array[task->first_job - 1].goal;
+    u32     remaining   = 0;
+
+    scratch->id++;
+
+    for (u32 j = task->first_job; j; j = path_job_array[j - 1].next_in_task) {
+        path_job_t* job = &path_job_array[j - 1];
+
+        if (path_job_begin(job)) {
+            scratch->closed[map_index(job->start.x, job->start.y)] = scratch->id;
+            remaining++;
+        }
+    }
+
+    if (!remaining) return;
+
+    path_search_reverse(scratch, goal, remaining);
+
+    for (u32 j = task->first_job; j; j = path_job_array[j - 1].next_in_task) {
+        path_job_t* job = &path_job_array[j - 1];
+
+        if (scratch->closed[map_index(job->start.x, job->start.y)] != scratch->id) continue;
+
+        if (scratch->visited[map_index(job->start.x, job->start.y)] == scratch->id) {
+            path_build_corridor_reverse(scratch, &job->corridor, job->start, job->goal);
+        } else {
+            memcpy(job->corridor.region, scratch->region, sizeof (job->corridor.region));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// main thread:
+
+// also used to start over, waits for anything still in flight first:
+static void path_service_init(void) {
+    if (path_batch_active) {
+        job_wait(&path_batch, 0);
+        path_batch_active = false;
+    }
+
+    memset(path_slot_array, 0, sizeof (path_slot_array));
+
+    // the next change list can't be trusted to cover everything, so the first 'path_track_changes' marks it all:
+    path_track_all = true;
+
+    path_free_count = 0;
+
+    for (u32 i = PATH_SLOT_MAX; i > 0; --i) {
+        path_free_array[path_free_count++] = i;
+    }
+}
+
+static path_slot_t* path_get_slot(u32 handle) {
+    if (handle == 0 || handle > PATH_SLOT_MAX) return NULL;
+    return &path_slot_array[handle - 1];
+}
+
+static u32 path_service_acquire(void) {
+    if (path_free_count == 0) return 0;
+
+    u32             handle  = path_free_array[--path_free_count];
+    path_slot_t*    slot    = path_get_slot(handle);
+
+    slot->in_use    = true;
+    slot->pending   = false;
+    slot->requested = false;
+    slot->solved    = false;
+
+    return handle;
+}
+
+static void path_service_release(u32 handle) {
+    path_slot_t* slot = path_get_slot(handle);
+    if (!slot || !slot->in_use) return;
+
+    // cancels anything still in flight for this handle:
+    atomic_inc_u32(&slot->generation);
+
+    slot->in_use    = false;
+    slot->pending   = false;
+    slot->requested = false;
+    slot->solved    = false;
+
+    path_free_array[path_free_count++] = handle;
+}
+
+// true once a search for the current target has come back empty:
+static b32 path_service_is_unreachable(u32 handle) {
+    path_slot_t* slot = path_get_slot(handle);
+    return slot && slot->in_use && slot->solved && !slot->pending && !slot->corridor.found;
+}
+
+static u64 path_service_expansion_count(void) {
+    u64 count = 0;
+
+    for (u32 i = 0; i < JOB_THREAD_MAX; ++i) {
+        count += path_scratch_array[i].expansion_count;
+    }
+
+    return count;
+}
+
+// stamps the chunks around every change the service hasn't seen yet. A changed tile can only open the way out of a
+// flooded region if it is in it or next to it, so each change marks the chunks of its neighbours too:
+static void path_track_changes(const map_t* map) {
+    u32 unseen = map->version - path_tracked_version;
+
+    if (!unseen && !path_track_all) return;
+
+    // the newest 'unseen' entries of the list are the ones we missed, unless there were more changes than that:
+    if (path_track_all || map->change_overflow || unseen > map->change_count) {
+        for (u32 i = 0; i < PATH_REGION_COUNT; ++i) {
+            path_region_version[i] = map->version;
+        }
+    } else {
+        for (u32 i = map->change_count - unseen; i < map->change_count; ++i) {
+            vec2i_t pos     = map->change_array[i];
+            u32     version = map->version - (map->change_count - 1 - i);
+
+            path_region_version[path_region_index(pos.x, pos.y)] = version;
+
+            for (u32 j = 0; j < ARRAY_COUNT(path_dirs); ++j) {
+                vec2i_t next = v2i_add(pos, path_dirs[j]);
+                if (!OFF_MAP(next.x, next.y)) path_region_version[path_region_index(next.x, next.y)] = version;
+            }
+        }
+    }
+
+    path_track_all          = false;
+    path_tracked_version    = map->version;
+}
+
+// true if a chunk the failed search flooded changed after the map it searched on:
+static b32 path_region_changed(const path_slot_t* slot) {
+    const u32* region = slot->corridor.region;
+
+    for (u32 i = 0; i < PATH_REGION_COUNT; ++i) {
+        if (!region[i >> 5]) {
+            i |= 31;
+            continue;
+        }
+
+        if ((region[i >> 5] & (1u << (i & 31))) && (i32)(path_region_version[i] - slot->map_version) > 0) return true;
+    }
+
+    return false;
+}
+
+// only touches the slot, so entities steering on different threads never share anything:
+static void path_service_request(path_slot_t* slot, u32 handle, vec2i_t start, vec2i_t goal) {
+    // retargeting makes every older request for this handle stale:
+    atomic_inc_u32(&slot->generation);
+
+    slot->goal          = goal;
+    slot->pending       = true;
+    slot->requested     = true;
+    slot->request_start = start;
+}
+
+static b32 path_corridor_is_clear(const path_slot_t* slot, vec2_t pos, const map_t* map) {
+    const path_corridor_t* corridor = &slot->corridor;
+
+    for (u32 i = slot->waypoint_index; i < corridor->waypoint_count; ++i) {
+        vec2_t next = path_tile_center(corridor->waypoint_array[i]);
+
+        if (!path_line_of_sight(pos, next, map, NULL, slot->goal)) return false;
+        pos = next;
+    }
+
+    return true;
+}
+
+// decides whether the cached corridor still does the job, and asks for a new one if it doesn't:
+static void path_validate_corridor(path_slot_t* slot, u32 handle, const map_t* map, vec2_t pos, vec2_t target, vec2i_t start, vec2i_t goal) {
+    path_corridor_t* corridor = &slot->corridor;
+
+    if (slot->pending) {
+        // not handed to the workers yet, aim it at the new goal. One already in flight is left to land:
+        if (slot->requested) {
+            slot->goal          = goal;
+            slot->request_start = start;
+        }
+
+        return;
+    }
+
+    if (!slot->solved) {
+        path_service_request(slot, handle, start, goal);
+        return;
+    }
+
+    if (!path_tile_equal(goal, slot->goal)) {
+        // target moved, bend the last leg towards it if that works:
+        if (corridor->found && corridor->complete && corridor->waypoint_count) {
+            u32     last = corridor->waypoint_count - 1;
+            vec2_t  from = (slot->waypoint_index < last)? path_tile_center(corridor->waypoint_array[last - 1]) : pos;
+
+            if (path_line_of_sight(from, target, map, NULL, goal)) {
+                corridor->waypoint_array[last]  = goal;
+                slot->goal                      = goal;
+                return;
+            }
+        }
+
+        path_service_request(slot, handle, start, goal);
+        return;
+    }
+
+    if (slot->map_version != map->version) {
+        // unreachable targets get another go once the map changes around the area the search got to:
+        // (changes 'path_track_changes' hasn't seen yet are left for the next look):
+        b32 retry = corridor->found? !path_corridor_is_clear(slot, pos, map) : path_region_changed(slot);
+
+        slot->map_version = corridor->found? map->version : path_tracked_version;
+
+        if (retry) path_service_request(slot, handle, start, goal);
+        return;
+    }
+
+    if (corridor->found && slot->waypoint_index >= corridor->waypoint_count) {
+        // walked off the end of a truncated corridor:
+        path_service_request(slot, handle, start, goal);
+    }
+}
+
+static vec2_t path_direction(vec2_t from, vec2_t to) {
+    vec2_t delta = v2_sub(to, from);
+    if (v2_len_sq(delta) < PATH_ARRIVE_RADIUS * PATH_ARRIVE_RADIUS) return v2(0);
+
+    return v2_norm(delta);
+}
+
+static vec2_t path_service_steer(u32 handle, const map_t* map, vec2_t pos, vec2_t target) {
+    path_slot_t* slot = path_get_slot(handle);
+    if (!slot || !slot->in_use) return v2(0);
+
+    vec2i_t start   = v2_cast(vec2i_t, pos);
+    vec2i_t goal    = v2_cast(vec2i_t, target);
+
+    if (OFF_MAP(start.x, start.y) || OFF_MAP(goal.x, goal.y)) return v2(0);
+
+    if (path_tile_equal(start, goal) || path_line_of_sight(pos, target, map, NULL, goal)) {
+        return path_direction(pos, target);
+    }
+
+    path_validate_corridor(slot, handle, map, pos, target, start, goal);
+
+    path_corridor_t* corridor = &slot->corridor;
+    if (!corridor->found || slot->waypoint_index >= corridor->waypoint_count) return v2(0);
+
+    // skip waypoints we've reached or can already see past:
+    while (slot->waypoint_index + 1 < corridor->waypoint_count) {
+        vec2i_t current = corridor->waypoint_array[slot->waypoint_index];
+        vec2i_t next    = corridor->waypoint_array[slot->waypoint_index + 1];
+
+        if (!path_tile_equal(start, current) && !path_line_of_sight(pos, path_tile_center(next), map, NULL, goal)) break;
+        slot->waypoint_index++;
+    }
+
+    vec2i_t waypoint = corridor->waypoint_array[slot->waypoint_index];
+
+    if (slot->waypoint_index + 1 == corridor->waypoint_count) {
+        if (corridor->complete) return path_direction(pos, target);
+
+        if (path_tile_equal(start, waypoint)) {
+            slot->waypoint_index++;
+            return v2(0);
+        }
+    }
+
+    // knocked off the corridor, look for a new one from here:
+    if (!slot->pending && !path_line_of_sight(pos, path_tile_center(waypoint), map, NULL, goal)) {
+        path_service_request(slot, handle, start, goal);
+    }
+
+    return path_direction(pos, path_tile_center(waypoint));
+}
+
+// main thread, start of the tick: hand finished corridors over to their slots.
+static void path_service_collect(const map_t* map) {
+    path_track_changes(map);
+
+    if (!path_batch_active || !job_is_done(&path_batch)) return;
+
+    for (u32 i = 0; i < path_request_count; ++i) {
+        const path_request_t*   request = &path_request_array[i];
+        const path_job_t*       job     = &path_job_array[request->job_index];
+        path_slot_t*            slot    = &path_slot_array[request->handle - 1];
+
+        if (!slot->in_use || slot->generation != request->generation) continue;
+
+        slot->pending           = false;
+        slot->solved            = true;
+        slot->corridor          = job->corridor;
+        slot->waypoint_index    = 0;
+
+        // searched on the snapshot, tiles changed since then are picked up by the version check:
+        slot->map_version       = path_walkable_version;
+    }
+
+    path_batch_active = false;
+}
+
+// main thread, end of the tick: kick off everything requested this tick, never waits for the workers.
+// Requests are gathered from the slots in handle order:
+static void path_service_submit(const map_t* map) {
+    path_track_changes(map);
+
+    if (path_batch_active) return;
+
+    path_job_hash_id++;
+    path_request_count  = 0;
+    path_job_count      = 0;
+    path_task_count     = 0;
+
+    for (u32 i = 0; i < PATH_SLOT_MAX; ++i) {
+        path_slot_t* slot = &path_slot_array[i];
+
+        if (!slot->requested) continue;
+
+        slot->requested = false;
+
+        path_request_t pending = {
+            .handle     = i + 1,
+            .generation = slot->generation,
+            .start      = slot->request_start,
+            .goal       = slot->goal,
+        };
+
+        u32 key     = (pending.start.y * MAP_SIZE + pending.start.x) * 31 + (pending.goal.y * MAP_SIZE + pending.goal.x);
+        u32 bucket  = (key * 2654435761u) & (PATH_JOB_HASH_SIZE - 1);
+
+        while (path_job_hash_stamp[bucket] == path_job_hash_id) {
+            const path_job_t* job = &path_job_array[path_job_hash_index[bucket]];
+            if (path_tile_equal(job->start, pending.start) && path_tile_equal(job->goal, pending.goal)) break;
+
+            bucket = (bucket + 1) & (PATH_JOB_HASH_SIZE - 1);
+        }
+
+        if (path_job_hash_stamp[bucket] != path_job_hash_id) {
+            path_job_hash_stamp[bucket] = path_job_hash_id;
+            path_job_hash_index[bucket] = path_job_count;
+
+            path_job_array[path_job_count++] = (path_job_t) { .start = pending.start, .goal = pending.goal };
+
+            // and the task for its goal:
+            u32 goal_bucket = ((pending.goal.y * MAP_SIZE + pending.goal.x) * 2654435761u) & (PATH_JOB_HASH_SIZE - 1);
+
+            while (path_task_hash_stamp[goal_bucket] == path_job_hash_id) {
+                const path_task_t* task = &path_task_array[path_task_hash_index[goal_bucket]];
+                if (path_tile_equal(path_job_array[task->first_job - 1].goal, pending.goal)) break;
+
+                goal_bucket = (goal_bucket + 1) & (PATH_JOB_HASH_SIZE - 1);
+            }
+
+            if (path_task_hash_stamp[goal_bucket] != path_job_hash_id) {
+                path_task_hash_stamp[goal_bucket] = path_job_hash_id;
+                path_task_hash_index[goal_bucket] = path_task_count;
+
+                path_task_array[path_task_count++] = (path_task_t) {0};
+            }
+
+            path_task_t* task = &path_task_array[path_task_hash_index[goal_bucket]];
+
+            path_job_array[path_job_count - 1].next_in_task = task->first_job;
+
+            task->first_job = path_job_count;
+            task->job_count++;
+        }
+
+        path_job_t*     job     = &path_job_array[path_job_hash_index[bucket]];
+        path_request_t* request = &path_request_array[path_request_count++];
+
+        *request = pending;
+
+        request->job_index      = path_job_hash_index[bucket];
+        request->next_in_job    = job->first_request;
+        job->first_request      = path_request_count;
+    }
+
+    if (path_job_count) {
+        for_map(x, y) {
+            path_walkable[map_index(x, y)] = map_is_traversable(map, x, y);
+        }
+
+        path_walkable_version   = map->version;
+        path_batch_active       = true;
+        job_submit(&path_batch, path_solve_task, NULL, path_task_count);
+    }
+}
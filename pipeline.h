@@ -0,0 +1,74 @@
+
+// Pipelined simulation.
+//
+// The simulation runs on its own thread, one tick per frame, and finishes by extracting a render view into the back
+// buffer. Every frame the main thread waits for that tick, flips the buffers, hands over the input for the next tick and
+// draws the front view while the next tick runs. A frame then costs max(sim, render) instead of the sum, and what is
+// drawn is one tick behind the simulation.
+// Between 'pipeline_wait' and 'pipeline_start' the simulation is idle and the main thread may touch the game state.
+// With 'use_pipeline' off the same steps run back to back on the main thread.
+
+typedef struct pipeline_t {
+    game_state_t*   gs;
+    f32             dt;
+
+    b32             running;
+    semaphore_t     start;
+    semaphore_t     done;
+
+    u32             front;
+    render_view_t   view_array[2];
+} pipeline_t;
+
+static b32          use_pipeline = true;
+static pipeline_t   pipeline;
+
+static const render_view_t* pipeline_front_view(void) {
+    return &pipeline.view_array[pipeline.front];
+}
+
+static void pipeline_tick(void) {
+    update_game(pipeline.gs, pipeline.dt);
+    render_view_extract(&pipeline.view_array[!pipeline.front], pipeline.gs);
+}
+
+static void pipeline_thread(void* arg) {
+    while (true) {
+        semaphore_wait(&pipeline.start);
+        pipeline_tick();
+        semaphore_post(&pipeline.done, 1);
+    }
+}
+
+static void pipeline_init(game_state_t* gs) {
+    pipeline.gs = gs;
+
+    semaphore_init(&pipeline.start);
+    semaphore_init(&pipeline.done);
+
+    thread_start(pipeline_thread, NULL);
+}
+
+// waits for the tick in flight and makes it the front view:
+static void pipeline_wait(void) {
+    if (!pipeline.running) return;
+
+    semaphore_wait(&pipeline.done);
+
+    pipeline.running    = false;
+    pipeline.front      = !pipeline.front;
+}
+
+// runs the next tick with 'in', on the simulation thread if pipelined:
+static void pipeline_start(const input_t* in, f32 dt) {
+    input       = *in;
+    pipeline.dt = dt;
+
+    if (use_pipeline) {
+        pipeline.running = true;
+        semaphore_post(&pipeline.start, 1);
+    } else {
+        pipeline_tick();
+        pipeline.front = !pipeline.front;
+    }
+}
@@ -0,0 +1,71 @@
+
+// Per phase timers for the simulation. 'profile_block' adds the time spent in the block to the phase total,
+// which is read and cleared by whoever is interested (the benchmark, or a debug overlay).
+
+typedef u32 profile_phase_t;
+enum {
+    PROFILE_AI,
+    PROFILE_PHYSICS,
+    PROFILE_COLLISIONS,
+    PROFILE_VISIBILITY,
+    PROFILE_LIGHT,
+    PROFILE_PHEROMONE,
+    PROFILE_MAP,
+    PROFILE_COLONY,
+    PROFILE_PARTICLES,
+    PROFILE_MINIMAP,
+    PROFILE_SAVE,
+    //
+    PROFILE_COUNT,
+};
+
+static const char* profile_phase_name[PROFILE_COUNT] = {
+    [PROFILE_AI]            = "ai",
+    [PROFILE_PHYSICS]       = "physics",
+    [PROFILE_COLLISIONS]    = "collisions",
+    [PROFILE_VISIBILITY]    = "visibility",
+    [PROFILE_LIGHT]         = "light",
+    [PROFILE_PHEROMONE]     = "pheromone",
+    [PROFILE_MAP]           = "map",
+    [PROFILE_COLONY]        = "colony",
+    [PROFILE_PARTICLES]     = "particles",
+    [PROFILE_MINIMAP]       = "minimap",
+    [PROFILE_SAVE]          = "save",
+};
+
+static f64 profile_phase_time[PROFILE_COUNT];
+static f64 profile_phase_start[PROFILE_COUNT];
+
+// seconds, from a high resolution monotonic clock:
+static f64 profile_time(void) {
+#if defined(_WIN32)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (f64)counter.QuadPart / (f64)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void profile_begin(profile_phase_t phase) {
+    profile_phase_start[phase] = profile_time();
+}
+
+static void profile_end(profile_phase_t phase) {
+    profile_phase_time[phase] += profile_time() - profile_phase_start[phase];
+}
+
+static void profile_reset(void) {
+    for (u32 i = 0; i < PROFILE_COUNT; ++i) {
+        profile_phase_time[i] = 0;
+    }
+}
+
+#define profile_block(phase) defer(profile_begin(phase), profile_end(phase))
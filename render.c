@@ -1,6 +1,11 @@
 
 static texture_table_t  texture_table = {0};
 static gl_texture_t     texture_atlas = {0};
+static gl_texture_t     minimap_texture = {0};
+
+// bake the tile lightmap into the vertex colors instead of using point lights:
+static b32              use_lightmap  = true;
+static b32              show_minimap  = true;
 
 typedef struct light_t {
     vec3_t      pos;
@@ -41,9 +46,15 @@ static void enable_lights(void) {
     light_count = 0;
 }
 
+// half brightness, for tiles that have been explored but aren't seen by anyone right now:
+static u32 dim_color(u32 color) {
+    return (color & 0xff000000) | ((color >> 1) & 0x007f7f7f);
+}
+
 static void render_init(void) {
     texture_table = tt_load_from_dir("assets/textures/", &ma);
     texture_atlas = gl_texture_create(texture_table.image.pixels, texture_table.image.width, texture_table.image.height, false);
+    minimap_texture = gl_texture_create(minimap_pixels, MINIMAP_SIZE, MINIMAP_SIZE, false);
 
     sr_init();
     sr_init_bitmap();
@@ -51,23 +62,37 @@ static void render_init(void) {
     sr_set_texture(texture_atlas);
 }
 
-static void render_map(game_state_t* gs) {
+static void render_map(const render_view_t* rv) {
     // render tiles:
-    defer(sr_begin(GL_TRIANGLES, sr_shader), sr_end()) {
-        for_map(x, y) {
-            if (v2_dist_sq(gs->cam.pos.xy, v2(x + 0.5, y + 0.5)) > 32 * 32) {
+    defer(sr_begin(GL_TRIANGLES, use_lightmap? sr_texture_shader : sr_shader), sr_end()) {
+        for (i32 j = 0; j < RENDER_VIEW_SIZE; ++j)
+        for (i32 i = 0; i < RENDER_VIEW_SIZE; ++i) {
+            i32 x = rv->origin.x + i;
+            i32 y = rv->origin.y + j;
+
+            if (v2_dist_sq(rv->cam.pos.xy, v2(x + 0.5, y + 0.5)) > 32 * 32) {
+                continue;
+            }
+
+            const render_tile_t* tile = &rv->tiles[j][i];
+
+            if (tile->fog == RENDER_FOG_UNEXPLORED) {
                 continue;
             }
 
-            tile_t* tile = &gs->map.tiles[y][x];
-            const tile_info_t* info = tile_get_info(tile);
+            const tile_info_t* info = &tile_info_table[tile->type];
 
-            rect2_t tex_rect = tt_get(&texture_table, info->texture);
+            rect2_t tex_rect    = tt_get(&texture_table, info->texture);
+            u32     color       = use_lightmap? light_shade(info->color, tile->light) : info->color;
+
+            if (tile->fog != RENDER_FOG_VISIBLE) {
+                color = dim_color(color);
+            }
 
             if (info->is_wall) {
-                sr_texture_box(tex_rect, (rect3_t) { x, y, 0, x + 1, y + 1, 1 }, info->color);
+                sr_texture_box(tex_rect, (rect3_t) { x, y, 0, x + 1, y + 1, 1 }, color);
             } else {
-                sr_texture_rect(tex_rect, (rect2_t) { x, y, x + 1, y + 1 }, 0, info->color);
+                sr_texture_rect(tex_rect, (rect2_t) { x, y, x + 1, y + 1 }, 0, color);
             }
 
             if (tile->order) {
@@ -96,29 +121,70 @@ static void render_map(game_state_t* gs) {
 #endif
 }
 
-static void render_entities(game_state_t* gs) {
+static void render_entities(const render_view_t* rv) {
     defer(sr_begin(GL_TRIANGLES, sr_texture_shader), sr_end()) {
-        for (u32 i = 0; i < gs->entity_count; ++i) {
-            entity_t*               e           = &gs->entity_array[i];
-            const entity_info_t*    info        = entity_get_info(e);
+        for (u32 i = 0; i < rv->entity_count; ++i) {
+            const render_entity_t*  e           = &rv->entity_array[i];
+            const entity_info_t*    info        = &entity_info_table[e->type];
             rect2_t                 tex_rect    = tt_get(&texture_table, info->texture);
-            rect2_t                 rect        = entity_get_rect(e);
+            rect2_t                 rect        = { e->pos.x - info->rad, e->pos.y - info->rad, e->pos.x + info->rad, e->pos.y + info->rad };
 
-            add_light(&(light_t) {
-                .pos        = v3(e->pos.x, e->pos.y, 1.5),
-                .range      = 8,
-                .value      = 1.0,
-                .color      = pack_color_f32(1, 0.8, 0.4, 1),
-            });
+            u32 color = info->color;
+
+            if (use_lightmap) {
+                color = light_shade(color, e->light);
+            } else {
+                add_light(&(light_t) {
+                    .pos        = v3(e->pos.x, e->pos.y, 1.5),
+                    .range      = 8,
+                    .value      = 1.0,
+                    .color      = pack_color_f32(1, 0.8, 0.4, 1),
+                });
+            }
+
+            if (e->selected) {
+                sr_texture_rect(tex_rect, rect2(rect.min.x - 0.08, rect.min.y - 0.08, rect.max.x + 0.08, rect.max.y + 0.08), 0.018, 0xff44ff44);
+            }
 
             sr_texture_rect(tex_rect, rect2(rect.min.x + 0.05, rect.min.y + 0.05, rect.max.x + 0.05, rect.max.y + 0.05), 0.019, 0xbb000000);
-            sr_texture_rect(tex_rect, rect, 0.020, info->color);
+            sr_texture_rect(tex_rect, rect, 0.020, color);
         }
     }
 }
 
-static void render_game(game_state_t* gs) {
-    camera_t* cam = &gs->cam;
+// uploads the blocks that changed, even when hidden, so the texture is up to date once it is shown again:
+static void render_minimap(const render_view_t* rv) {
+    glBindTexture(GL_TEXTURE_2D, minimap_texture.id);
+
+    for (u32 i = 0; i < rv->minimap_block_count; ++i) {
+        u32 x = (rv->minimap_block_index[i] % MINIMAP_BLOCK_ROW) * MINIMAP_BLOCK;
+        u32 y = (rv->minimap_block_index[i] / MINIMAP_BLOCK_ROW) * MINIMAP_BLOCK;
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, MINIMAP_BLOCK, MINIMAP_BLOCK, GL_RGBA, GL_UNSIGNED_BYTE, rv->minimap_block_pixels[i]);
+    }
+
+    if (!show_minimap) return;
+
+    f32     aspect  = platform.aspect_ratio;
+    f32     size    = 0.5f;
+    mat4_t  ortho   = m4_ortho(-aspect, aspect, -1, 1, -1, 1);
+
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    gl_shader_use(sr_texture_shader);
+    gl_uniform_m4(gl_shader_location(sr_texture_shader, "pvm"), ortho);
+
+    sr_set_texture(minimap_texture);
+
+    defer(sr_begin(GL_TRIANGLES, sr_texture_shader), sr_end()) {
+        sr_texture_rect(rect2(0, 0, 1, 1), rect2(aspect - size - 0.05f, 0.95f - size, aspect - 0.05f, 0.95f), 0, 0xffffffff);
+    }
+
+    sr_set_texture(texture_atlas);
+}
+
+static void render_game(const render_view_t* rv) {
+    const camera_t* cam = &rv->cam;
 
     projection = m4_perspective(0.5 * PI, platform.aspect_ratio, 0.1, 32.0f);
     view       = m4_look_at(cam->pos, v3(.xy = cam->pos.xy), v3(0, 1, 0));
@@ -134,7 +200,12 @@ static void render_game(game_state_t* gs) {
     gl_shader_use(sr_shader);
     gl_uniform_m4(gl_shader_location(sr_shader, "pvm"), pvm);
 
-    {
+    if (use_lightmap) {
+        sr_disable_all_lights();
+
+        render_map(rv);
+        render_entities(rv);
+    } else {
         add_light(&(light_t) {
             .pos    = v3(cam->pos.x, cam->pos.y, 4.0),
             .range  = 32,
@@ -142,8 +213,8 @@ static void render_game(game_state_t* gs) {
             .color  = pack_color_f32(1, 0.8, 0.4, 1),
         });
 
-        render_map(gs);
-        render_entities(gs);
+        render_map(rv);
+        render_entities(rv);
 
         enable_lights();
     }
@@ -167,17 +238,35 @@ static void render_game(game_state_t* gs) {
         sr_vertex(pos.x - 0, pos.y - 0, z + 0.021);
     }
 
+    if (rv->selecting) {
+        defer(sr_begin(GL_TRIANGLES, sr_basic_shader), sr_end()) {
+            rect2_t r = rv->select_rect;
+
+            sr_color(0x3344ff44);
+
+            sr_vertex(r.min.x, r.min.y, 0.022);
+            sr_vertex(r.max.x, r.min.y, 0.022);
+            sr_vertex(r.max.x, r.max.y, 0.022);
+
+            sr_vertex(r.max.x, r.max.y, 0.022);
+            sr_vertex(r.min.x, r.max.y, 0.022);
+            sr_vertex(r.min.x, r.min.y, 0.022);
+        }
+    }
+
     defer(sr_begin(GL_TRIANGLES, sr_ui_text_shader), sr_end()) {
-        sr_render_string_format(32, 32, 0, 12, 12, 0xffbbbbbb, order_info_table[gs->order_tool].name);
+        sr_render_string_format(32, 32, 0, 12, 12, 0xffbbbbbb, order_info_table[rv->order_tool].name);
 
-        tile_t* tile = map_get_tile(&gs->map, mouse_position.x, mouse_position.y);
-        if (tile) {
-            const tile_info_t* info = tile_get_info(tile);
+        const render_tile_t* tile = render_view_get_tile(rv, floorf(mouse_position.x), floorf(mouse_position.y));
+        if (tile && tile->fog != RENDER_FOG_UNEXPLORED) {
+            const tile_info_t* info = &tile_info_table[tile->type];
 
             if (info->name[0] != '\0') {
                 sr_render_string_format(platform.mouse.pos.x + 24, platform.mouse.pos.y + 12, 0, 12, 12, 0xffffffff, info->name);
             }
         }
     }
+
+    render_minimap(rv);
 }
 
@@ -0,0 +1,123 @@
+
+// Everything the renderer needs from one tick, copied out of the game state at the end of the tick.
+// The renderer only ever reads a view, so it can draw tick N while the simulation is busy with tick N + 1.
+// Only the tiles around the camera are kept, together with their light and fog, and only the entities that can be seen.
+
+#define RENDER_VIEW_RADIUS  (32)
+#define RENDER_VIEW_SIZE    (2 * RENDER_VIEW_RADIUS + 2)
+
+typedef u8 render_fog_t;
+enum {
+    RENDER_FOG_UNEXPLORED,
+    RENDER_FOG_EXPLORED,
+    RENDER_FOG_VISIBLE,
+};
+
+typedef struct render_tile_t {
+    tile_type_t     type;
+    order_type_t    order;
+    u8              light;
+    render_fog_t    fog;
+} render_tile_t;
+
+typedef struct render_entity_t {
+    entity_type_t   type;
+    vec2_t          pos;
+    u32             light;
+    b32             selected;
+} render_entity_t;
+
+typedef struct render_view_t {
+    u32             tick;
+
+    camera_t        cam;
+    order_type_t    order_tool;
+
+    b32             selecting;
+    rect2_t         select_rect;
+
+    // tile (x, y) is tiles[y - origin.y][x - origin.x]:
+    vec2i_t         origin;
+    render_tile_t   tiles[RENDER_VIEW_SIZE][RENDER_VIEW_SIZE];
+
+    u32             entity_count;
+    render_entity_t entity_array[ENTITY_MAX];
+
+    // the minimap blocks that changed since the last view, to be uploaded when this one is drawn:
+    u32             minimap_block_count;
+    u16             minimap_block_index[MINIMAP_BLOCK_COUNT];
+    u32             minimap_block_pixels[MINIMAP_BLOCK_COUNT][MINIMAP_BLOCK * MINIMAP_BLOCK];
+} render_view_t;
+
+static const render_tile_t* render_view_get_tile(const render_view_t* view, i32 x, i32 y) {
+    x -= view->origin.x;
+    y -= view->origin.y;
+
+    if (x < 0 || x >= RENDER_VIEW_SIZE || y < 0 || y >= RENDER_VIEW_SIZE) return NULL;
+    return &view->tiles[y][x];
+}
+
+static void render_view_extract(render_view_t* view, const game_state_t* gs) {
+    view->tick++;
+
+    view->cam           = gs->cam;
+    view->order_tool    = gs->order_tool;
+    view->selecting     = gs->selecting;
+    view->select_rect   = (rect2_t) {
+        MIN(gs->select_start.x, gs->select_end.x), MIN(gs->select_start.y, gs->select_end.y),
+        MAX(gs->select_start.x, gs->select_end.x), MAX(gs->select_start.y, gs->select_end.y),
+    };
+    view->origin        = v2i((i32)floorf(gs->cam.pos.x) - RENDER_VIEW_RADIUS, (i32)floorf(gs->cam.pos.y) - RENDER_VIEW_RADIUS);
+
+    for (i32 j = 0; j < RENDER_VIEW_SIZE; ++j) {
+        for (i32 i = 0; i < RENDER_VIEW_SIZE; ++i) {
+            i32             x   = view->origin.x + i;
+            i32             y   = view->origin.y + j;
+            render_tile_t*  out = &view->tiles[j][i];
+
+            if (!vis_is_explored(x, y)) {
+                *out = (render_tile_t) { .fog = RENDER_FOG_UNEXPLORED };
+                continue;
+            }
+
+            const tile_t* tile = &gs->map.tiles[map_index(x, y)];
+
+            out->type   = tile->type;
+            out->order  = tile->order;
+            out->light  = light_get(x, y);
+            out->fog    = vis_is_visible(x, y)? RENDER_FOG_VISIBLE : RENDER_FOG_EXPLORED;
+        }
+    }
+
+    view->entity_count = 0;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        const entity_t* e = &gs->entity_array[i];
+
+        if (!entity_is_viewer(e) && !vis_is_visible(e->pos.x, e->pos.y)) continue;
+
+        view->entity_array[view->entity_count++] = (render_entity_t) {
+            .type       = e->type,
+            .pos        = e->pos,
+            .light      = light_get(e->pos.x, e->pos.y),
+            .selected   = e->selected,
+        };
+    }
+
+    view->minimap_block_count = 0;
+
+    for (u32 i = 0; i < MINIMAP_BLOCK_COUNT; ++i) {
+        if (!minimap_dirty[i]) continue;
+
+        u32         index   = view->minimap_block_count++;
+        u32*        out     = view->minimap_block_pixels[index];
+        const u32*  in      = &minimap_pixels[(i / MINIMAP_BLOCK_ROW) * MINIMAP_BLOCK * MINIMAP_SIZE + (i % MINIMAP_BLOCK_ROW) * MINIMAP_BLOCK];
+
+        for (u32 row = 0; row < MINIMAP_BLOCK; ++row) {
+            memcpy(out + row * MINIMAP_BLOCK, in + row * MINIMAP_SIZE, MINIMAP_BLOCK * sizeof (u32));
+        }
+
+        view->minimap_block_index[index] = i;
+        minimap_dirty[i] = false;
+    }
+}
@@ -0,0 +1,547 @@
+
+// Autosave.
+//
+// Saving is split in two: the main thread copies everything that gets saved into 'save_snapshot' (a few memcpys, this
+// is the only stall), and the save thread does the rest while the simulation keeps going. The save thread keeps the
+// tiles of the last save around and compares chunk by chunk, so only chunks that changed since then are written
+// (a delta appended to the delta file). Every SAVE_DELTA_MAX deltas, or when most of the map changed, a full save
+// replaces the save file and the delta file starts over. Every full save gets a new random chain id that its deltas
+// carry too, so deltas left over from an older save (say the game died between replacing the save file and clearing
+// the delta file) are never applied to it.
+// Chunks are stored as byte planes (the n-th byte of every tile, then the next) with run length encoding, which
+// squeezes the mostly uniform tile data a lot. Tiles within a chunk are written row major, whatever the map layout.
+
+#define SAVE_MAGIC          (0x56415347)
+#define SAVE_VERSION        (6)
+#define SAVE_CHUNK          (32)
+#define SAVE_CHUNK_COUNT    ((MAP_SIZE / SAVE_CHUNK) * (MAP_SIZE / SAVE_CHUNK))
+#define SAVE_CHUNK_BYTES    (SAVE_CHUNK * SAVE_CHUNK * sizeof (tile_t))
+#define SAVE_DELTA_MAX      (16)
+#define SAVE_INTERVAL       (60.0f)
+#define SAVE_STATS_MAX      (64)
+
+#define SAVE_PATH           "autosave.sav"
+#define SAVE_DELTA_PATH     "autosave.delta"
+#define SAVE_TEMP_PATH      "autosave.tmp"
+
+typedef u32 save_kind_t;
+enum {
+    SAVE_KIND_FULL,
+    SAVE_KIND_DELTA,
+};
+
+typedef struct save_header_t {
+    u32             magic;
+    u32             version;
+    save_kind_t     kind;
+    u32             seq;
+    // id of the full save this record builds on:
+    u32             chain;
+    u32             chunk_count;
+    u32             size;
+} save_header_t;
+
+typedef struct save_stats_t {
+    b32             full;
+    u32             chunk_count;
+    // of the record, 0 if it couldn't be written:
+    u32             size;
+
+    // main thread, taking the snapshot:
+    f64             stall;
+    // save thread, encoding and writing:
+    f64             write_time;
+} save_stats_t;
+
+typedef struct save_globals_t {
+    u32             seed;
+    camera_t        cam;
+    order_type_t    order_tool;
+    u32             next_id;
+    u32             entity_count;
+} save_globals_t;
+
+typedef struct save_snapshot_t {
+    save_globals_t  globals;
+    entity_t        entity_array[ENTITY_MAX];
+    colony_chunk_t  colony_chunk_array[COLONY_CHUNK_COUNT];
+    // same layout as map_t.tiles:
+    tile_t          tiles[MAP_SIZE * MAP_SIZE];
+} save_snapshot_t;
+
+// worst case record: every chunk, each one a little bigger than raw:
+#define SAVE_BUFFER_SIZE (sizeof (save_globals_t) + ENTITY_MAX * sizeof (entity_t) + \
+                          COLONY_CHUNK_COUNT * sizeof (colony_chunk_t) + \
+                          SAVE_CHUNK_COUNT * (2 * sizeof (u32) + SAVE_CHUNK_BYTES + SAVE_CHUNK_BYTES / 128 + 1))
+
+static f32              save_interval   = SAVE_INTERVAL;
+static f32              save_timer;
+
+// main thread -> save thread:
+static volatile u32     save_busy;
+static semaphore_t      save_semaphore;
+static save_snapshot_t  save_snapshot;
+
+// owned by the save thread:
+static b32              save_base_valid;
+static u32              save_seq;
+static u32              save_chain;
+static u32              save_delta_count;
+static tile_t           save_base_tiles[MAP_SIZE * MAP_SIZE];
+static u8               save_buffer[SAVE_BUFFER_SIZE];
+
+// one entry per finished save, 'save_stats_count' is bumped once its entry is complete. The main thread fills in the
+// stall of the save it hands over, the save thread the rest. The bench reads them as they come in:
+static save_stats_t     save_stats_array[SAVE_STATS_MAX];
+static volatile u32     save_stats_count;
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// chunk encoding:
+
+// runs of 3 to 130 equal bytes are 'count + 125' and the byte, anything else is 'count - 1' and up to 128 literal bytes:
+static u32 save_rle_encode(u8* out, const u8* in, u32 size) {
+    u32 o = 0;
+    u32 i = 0;
+
+    while (i < size) {
+        u32 run = 1;
+        while (i + run < size && run < 130 && in[i + run] == in[i]) run++;
+
+        if (run >= 3) {
+            out[o++] = (u8)(run + 125);
+            out[o++] = in[i];
+
+            i += run;
+            continue;
+        }
+
+        u32 start = i;
+        u32 count = 0;
+
+        while (i < size && count < 128) {
+            if (i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2]) break;
+
+            i++;
+            count++;
+        }
+
+        out[o++] = (u8)(count - 1);
+        memcpy(out + o, in + start, count);
+        o += count;
+    }
+
+    return o;
+}
+
+static b32 save_rle_decode(u8* out, u32 out_size, const u8* in, u32 in_size) {
+    u32 o = 0;
+    u32 i = 0;
+
+    while (i < in_size) {
+        u32 c = in[i++];
+
+        if (c < 128) {
+            u32 count = c + 1;
+            if (i + count > in_size || o + count > out_size) return false;
+
+            memcpy(out + o, in + i, count);
+
+            i += count;
+            o += count;
+        } else {
+            u32 count = c - 125;
+            if (i >= in_size || o + count > out_size) return false;
+
+            memset(out + o, in[i++], count);
+            o += count;
+        }
+    }
+
+    return o == out_size;
+}
+
+static u32 save_encode_chunk(u8* out, const tile_t* tiles, u32 chunk) {
+    static u8 planes[SAVE_CHUNK_BYTES];
+
+    i32 cx  = (chunk % (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+    i32 cy  = (chunk / (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+    u32 n   = 0;
+
+    for (i32 y = 0; y < SAVE_CHUNK; ++y) {
+        for (i32 x = 0; x < SAVE_CHUNK; ++x) {
+            const u8* bytes = (const u8*)&tiles[map_index(cx + x, cy + y)];
+
+            for (u32 b = 0; b < sizeof (tile_t); ++b) {
+                planes[b * SAVE_CHUNK * SAVE_CHUNK + n] = bytes[b];
+            }
+
+            n++;
+        }
+    }
+
+    return save_rle_encode(out, planes, SAVE_CHUNK_BYTES);
+}
+
+static b32 save_decode_chunk(tile_t* tiles, u32 chunk, const u8* in, u32 size) {
+    static u8 planes[SAVE_CHUNK_BYTES];
+
+    if (chunk >= SAVE_CHUNK_COUNT) return false;
+    if (!save_rle_decode(planes, SAVE_CHUNK_BYTES, in, size)) return false;
+
+    i32 cx  = (chunk % (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+    i32 cy  = (chunk / (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+    u32 n   = 0;
+
+    for (i32 y = 0; y < SAVE_CHUNK; ++y) {
+        for (i32 x = 0; x < SAVE_CHUNK; ++x) {
+            u8* bytes = (u8*)&tiles[map_index(cx + x, cy + y)];
+
+            for (u32 b = 0; b < sizeof (tile_t); ++b) {
+                bytes[b] = planes[b * SAVE_CHUNK * SAVE_CHUNK + n];
+            }
+
+            n++;
+        }
+    }
+
+    return true;
+}
+
+// a chunk is made of whole rows of map blocks, and each of those rows is contiguous:
+static b32 save_chunk_changed(u32 chunk) {
+    i32 cx = (chunk % (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+    i32 cy = (chunk / (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+
+    for (i32 y = cy; y < cy + SAVE_CHUNK; y += MAP_BLOCK) {
+        u32 index = map_index(cx, y);
+
+        if (memcmp(&save_snapshot.tiles[index], &save_base_tiles[index], SAVE_CHUNK * MAP_BLOCK * sizeof (tile_t))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void save_copy_chunk_to_base(u32 chunk) {
+    i32 cx = (chunk % (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+    i32 cy = (chunk / (MAP_SIZE / SAVE_CHUNK)) * SAVE_CHUNK;
+
+    for (i32 y = cy; y < cy + SAVE_CHUNK; y += MAP_BLOCK) {
+        u32 index = map_index(cx, y);
+
+        memcpy(&save_base_tiles[index], &save_snapshot.tiles[index], SAVE_CHUNK * MAP_BLOCK * sizeof (tile_t));
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// save thread:
+
+static b32 save_replace_file(const char* from, const char* to) {
+#if defined(_WIN32)
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING);
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+// 'seq' starts over every run, the chain id has to be different from any save that might still be on disk:
+static u32 save_new_chain(void) {
+    static u64 counter;
+
+    u64 x = (u64)(profile_time() * 1e9) + ++counter * 0x9e3779b97f4a7c15ull;
+
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+
+    return (u32)x;
+}
+
+static void save_write(save_stats_t* stats) {
+    b32 changed[SAVE_CHUNK_COUNT];
+    u32 changed_count = 0;
+
+    for (u32 i = 0; i < SAVE_CHUNK_COUNT; ++i) {
+        changed[i] = !save_base_valid || save_chunk_changed(i);
+        changed_count += changed[i];
+    }
+
+    b32 full = !save_base_valid || save_delta_count >= SAVE_DELTA_MAX || changed_count > SAVE_CHUNK_COUNT / 2;
+
+    save_header_t header = {
+        .magic          = SAVE_MAGIC,
+        .version        = SAVE_VERSION,
+        .kind           = full? SAVE_KIND_FULL : SAVE_KIND_DELTA,
+        .seq            = ++save_seq,
+        .chain          = full? save_new_chain() : save_chain,
+        .chunk_count    = full? SAVE_CHUNK_COUNT : changed_count,
+    };
+
+    stats->full         = full;
+    stats->chunk_count  = header.chunk_count;
+    stats->size         = 0;
+
+    u32 size            = 0;
+    u32 entity_count    = save_snapshot.globals.entity_count;
+
+    memcpy(save_buffer + size, &save_snapshot.globals, sizeof (save_globals_t));
+    size += sizeof (save_globals_t);
+
+    memcpy(save_buffer + size, save_snapshot.entity_array, entity_count * sizeof (entity_t));
+    size += entity_count * sizeof (entity_t);
+
+    memcpy(save_buffer + size, save_snapshot.colony_chunk_array, sizeof (save_snapshot.colony_chunk_array));
+    size += sizeof (save_snapshot.colony_chunk_array);
+
+    for (u32 i = 0; i < SAVE_CHUNK_COUNT; ++i) {
+        if (!full && !changed[i]) continue;
+
+        u32 packed = save_encode_chunk(save_buffer + size + 2 * sizeof (u32), save_snapshot.tiles, i);
+
+        memcpy(save_buffer + size + 0 * sizeof (u32), &i,       sizeof (u32));
+        memcpy(save_buffer + size + 1 * sizeof (u32), &packed,  sizeof (u32));
+
+        size += 2 * sizeof (u32) + packed;
+    }
+
+    header.size = size;
+
+    FILE* file = fopen(full? SAVE_TEMP_PATH : SAVE_DELTA_PATH, full? "wb" : "ab");
+
+    if (!file) {
+        fprintf(stderr, "save: could not open file\n");
+        save_seq--;
+        return;
+    }
+
+    b32 written = fwrite(&header, sizeof (header), 1, file) == 1 && fwrite(save_buffer, 1, size, file) == size;
+
+    // a broken record ends the delta file for the loader, so the next save starts a new chain:
+    if (fclose(file) != 0 || !written) {
+        fprintf(stderr, "save: could not write %s\n", full? SAVE_TEMP_PATH : SAVE_DELTA_PATH);
+        save_base_valid = false;
+        save_seq--;
+        return;
+    }
+
+    if (full) {
+        if (!save_replace_file(SAVE_TEMP_PATH, SAVE_PATH)) {
+            fprintf(stderr, "save: could not replace %s\n", SAVE_PATH);
+            save_seq--;
+            return;
+        }
+
+        // the old deltas belong to the previous full save:
+        if ((file = fopen(SAVE_DELTA_PATH, "wb"))) fclose(file);
+
+        memcpy(save_base_tiles, save_snapshot.tiles, sizeof (save_base_tiles));
+
+        save_base_valid     = true;
+        save_chain          = header.chain;
+        save_delta_count    = 0;
+    } else {
+        for (u32 i = 0; i < SAVE_CHUNK_COUNT; ++i) {
+            if (changed[i]) save_copy_chunk_to_base(i);
+        }
+
+        save_delta_count++;
+    }
+
+    stats->size = sizeof (header) + size;
+}
+
+static void save_thread(void* arg) {
+    while (true) {
+        semaphore_wait(&save_semaphore);
+
+        save_stats_t* stats = &save_stats_array[save_stats_count % SAVE_STATS_MAX];
+
+        f64 start = profile_time();
+        save_write(stats);
+        stats->write_time = profile_time() - start;
+
+        atomic_store_u32(&save_stats_count, save_stats_count + 1);
+        atomic_store_u32(&save_busy, 0);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// main thread:
+
+static void save_init(void) {
+    semaphore_init(&save_semaphore);
+    thread_start(save_thread, NULL);
+}
+
+static void save_wait(void) {
+    while (atomic_load_u32(&save_busy)) {
+        thread_yield();
+    }
+}
+
+// takes the snapshot and hands it to the save thread, false if the last save is still being written:
+static b32 save_game(const game_state_t* gs) {
+    if (atomic_load_u32(&save_busy)) return false;
+
+    f64 start = profile_time();
+
+    save_snapshot.globals = (save_globals_t) {
+        .seed           = gs->seed,
+        .cam            = gs->cam,
+        .order_tool     = gs->order_tool,
+        .next_id        = gs->next_id,
+        .entity_count   = gs->entity_count,
+    };
+
+    memcpy(save_snapshot.entity_array, gs->entity_array, gs->entity_count * sizeof (entity_t));
+    memcpy(save_snapshot.colony_chunk_array, colony_chunk_array, sizeof (colony_chunk_array));
+    memcpy(save_snapshot.tiles, gs->map.tiles, sizeof (save_snapshot.tiles));
+
+    save_stats_array[save_stats_count % SAVE_STATS_MAX].stall = profile_time() - start;
+
+    atomic_store_u32(&save_busy, 1);
+    semaphore_post(&save_semaphore, 1);
+
+    return true;
+}
+
+static void update_autosave(game_state_t* gs, f32 dt) {
+    save_timer += dt;
+
+    if (save_timer >= save_interval || input.key_pressed[KEY_F5]) {
+        if (save_game(gs)) {
+            save_timer = 0;
+        }
+    }
+}
+
+// reads one record into 'snapshot', false at the end of the file or if it is broken:
+static b32 load_record(FILE* file, save_header_t* header, save_snapshot_t* snapshot) {
+    if (fread(header, sizeof (save_header_t), 1, file) != 1) return false;
+
+    if (header->magic != SAVE_MAGIC || header->version != SAVE_VERSION) return false;
+    if (header->size > SAVE_BUFFER_SIZE || fread(save_buffer, 1, header->size, file) != header->size) return false;
+
+    const u8*   it  = save_buffer;
+    const u8*   end = save_buffer + header->size;
+
+    save_globals_t globals;
+    if (it + sizeof (globals) > end) return false;
+
+    memcpy(&globals, it, sizeof (globals));
+    it += sizeof (globals);
+
+    if (globals.entity_count > ENTITY_MAX || it + globals.entity_count * sizeof (entity_t) > end) return false;
+
+    snapshot->globals = globals;
+    memcpy(snapshot->entity_array, it, globals.entity_count * sizeof (entity_t));
+    it += globals.entity_count * sizeof (entity_t);
+
+    if (it + sizeof (snapshot->colony_chunk_array) > end) return false;
+
+    memcpy(snapshot->colony_chunk_array, it, sizeof (snapshot->colony_chunk_array));
+    it += sizeof (snapshot->colony_chunk_array);
+
+    for (u32 i = 0; i < header->chunk_count; ++i) {
+        u32 chunk;
+        u32 packed;
+
+        if (it + 2 * sizeof (u32) > end) return false;
+
+        memcpy(&chunk,  it + 0 * sizeof (u32), sizeof (u32));
+        memcpy(&packed, it + 1 * sizeof (u32), sizeof (u32));
+        it += 2 * sizeof (u32);
+
+        if (it + packed > end || !save_decode_chunk(snapshot->tiles, chunk, it, packed)) return false;
+        it += packed;
+    }
+
+    return true;
+}
+
+// loads the last full save plus its deltas, the game state is left alone if there is nothing to load:
+static b32 load_game(game_state_t* gs) {
+    static save_snapshot_t loaded;
+
+    save_wait();
+
+    FILE* file = fopen(SAVE_PATH, "rb");
+    if (!file) return false;
+
+    save_header_t header;
+    b32 ok = load_record(file, &header, &loaded) && header.kind == SAVE_KIND_FULL;
+    fclose(file);
+
+    if (!ok) return false;
+
+    u32 chain = header.chain;
+
+    if ((file = fopen(SAVE_DELTA_PATH, "rb"))) {
+        // a delta that fails to read leaves 'loaded' at the state of the previous one:
+        static save_snapshot_t next;
+        next = loaded;
+
+        while (load_record(file, &header, &next)) {
+            if (header.kind == SAVE_KIND_DELTA && header.chain == chain) {
+                loaded = next;
+            } else {
+                next = loaded;
+            }
+        }
+
+        fclose(file);
+    }
+
+    gs->seed            = loaded.globals.seed;
+    gs->cam             = loaded.globals.cam;
+    gs->order_tool      = loaded.globals.order_tool;
+    gs->next_id         = loaded.globals.next_id;
+    gs->entity_count    = loaded.globals.entity_count;
+    gs->ai_dirty        = true;
+    gs->particle_count  = 0;
+
+    memcpy(gs->entity_array, loaded.entity_array, gs->entity_count * sizeof (entity_t));
+    memcpy(gs->map.tiles, loaded.tiles, sizeof (gs->map.tiles));
+
+    // handles point into systems that start over:
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        e->path_handle  = 0;
+        e->vis_handle   = 0;
+        e->group_handle = 0;
+        e->selected     = false;
+
+        // the group it was moving with is gone:
+        if (e->ai == AI_UNIT_MOVE) {
+            e->next_ai = entity_get_info(e)->ai;
+        }
+
+        entity_wake(e);
+    }
+
+    gs->selecting       = false;
+    gs->selected_count  = 0;
+
+    gs->map.version++;
+    map_clear_changes(&gs->map);
+
+    path_service_init();
+    group_init();
+    vis_init();
+    light_init();
+    minimap_init();
+    colony_init();
+    pheromone_init();
+
+    memcpy(colony_chunk_array, loaded.colony_chunk_array, sizeof (colony_chunk_array));
+
+    // the next save starts a new chain:
+    save_base_valid = false;
+    save_timer      = 0;
+
+    return true;
+}
@@ -0,0 +1,40 @@
+// What the cpu can do beyond the SSE2 every x64 build assumes.
+//
+// Code paths that need more are compiled with SIMD_AVX2 on the function (the rest of the build stays plain) and only
+// picked at runtime, after asking the cpu with 'simd_has_avx2'. Every such path keeps a scalar twin that does the same
+// operations in the same order, so either one gives the same result to the bit.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 (1)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define SIMD_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_AVX2
+#endif
+
+static b32 simd_has_avx2(void) {
+#if defined(SIMD_X86) && defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+
+    // the os has to save the ymm registers as well:
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(SIMD_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,119 @@
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define THREAD_MAX (32)
+
+typedef void thread_proc_t(void* arg);
+
+typedef struct thread_desc_t {
+    thread_proc_t*  proc;
+    void*           arg;
+} thread_desc_t;
+
+static u32              thread_count;
+static thread_desc_t    thread_desc_array[THREAD_MAX];
+
+#if defined(_WIN32)
+
+typedef CRITICAL_SECTION    mutex_t;
+typedef HANDLE              semaphore_t;
+
+static DWORD WINAPI thread_entry(LPVOID arg) {
+    thread_desc_t* desc = arg;
+    desc->proc(desc->arg);
+    return 0;
+}
+
+static b32 thread_start(thread_proc_t* proc, void* arg) {
+    if (thread_count >= THREAD_MAX) return false;
+
+    thread_desc_t* desc = &thread_desc_array[thread_count++];
+
+    desc->proc  = proc;
+    desc->arg   = arg;
+
+    HANDLE handle = CreateThread(NULL, 0, thread_entry, desc, 0, NULL);
+    if (!handle) return false;
+
+    CloseHandle(handle);
+    return true;
+}
+
+static u32 thread_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+static void thread_yield(void)          { SwitchToThread(); }
+
+static void mutex_init(mutex_t* m)      { InitializeCriticalSection(m); }
+static void mutex_lock(mutex_t* m)      { EnterCriticalSection(m); }
+static void mutex_unlock(mutex_t* m)    { LeaveCriticalSection(m); }
+
+static void semaphore_init(semaphore_t* s)          { *s = CreateSemaphoreA(NULL, 0, 0x7fffffff, NULL); }
+static void semaphore_post(semaphore_t* s, u32 n)   { ReleaseSemaphore(*s, n, NULL); }
+static void semaphore_wait(semaphore_t* s)          { WaitForSingleObject(*s, INFINITE); }
+
+static u32 atomic_inc_u32(volatile u32* value)          { return (u32)InterlockedIncrement((volatile LONG*)value); }
+static u32 atomic_add_u32(volatile u32* value, u32 n)   { return (u32)InterlockedExchangeAdd((volatile LONG*)value, (LONG)n) + n; }
+static u32 atomic_load_u32(volatile u32* value)         { return (u32)InterlockedCompareExchange((volatile LONG*)value, 0, 0); }
+static void atomic_store_u32(volatile u32* value, u32 n) { InterlockedExchange((volatile LONG*)value, (LONG)n); }
+
+#else
+
+typedef pthread_mutex_t mutex_t;
+typedef sem_t           semaphore_t;
+
+static void* thread_entry(void* arg) {
+    thread_desc_t* desc = arg;
+    desc->proc(desc->arg);
+    return NULL;
+}
+
+static b32 thread_start(thread_proc_t* proc, void* arg) {
+    if (thread_count >= THREAD_MAX) return false;
+
+    thread_desc_t* desc = &thread_desc_array[thread_count++];
+
+    desc->proc  = proc;
+    desc->arg   = arg;
+
+    pthread_t handle;
+    if (pthread_create(&handle, NULL, thread_entry, desc) != 0) return false;
+
+    pthread_detach(handle);
+    return true;
+}
+
+static u32 thread_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0? (u32)count : 1;
+}
+
+static void thread_yield(void)          { sched_yield(); }
+
+static void mutex_init(mutex_t* m)      { pthread_mutex_init(m, NULL); }
+static void mutex_lock(mutex_t* m)      { pthread_mutex_lock(m); }
+static void mutex_unlock(mutex_t* m)    { pthread_mutex_unlock(m); }
+
+static void semaphore_init(semaphore_t* s)          { sem_init(s, 0, 0); }
+static void semaphore_post(semaphore_t* s, u32 n)   { while (n--) sem_post(s); }
+static void semaphore_wait(semaphore_t* s)          { while (sem_wait(s) != 0); }
+
+static u32 atomic_inc_u32(volatile u32* value)          { return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST); }
+static u32 atomic_add_u32(volatile u32* value, u32 n)   { return __atomic_add_fetch(value, n, __ATOMIC_SEQ_CST); }
+static u32 atomic_load_u32(volatile u32* value)         { return __atomic_load_n(value, __ATOMIC_SEQ_CST); }
+static void atomic_store_u32(volatile u32* value, u32 n) { __atomic_store_n(value, n, __ATOMIC_SEQ_CST); }
+
+#endif
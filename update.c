@@ -1,46 +1,107 @@
 
+// selects the units touching 'rect', a click is just a very small rect:
+static void select_units(game_state_t* gs, vec2_t a, vec2_t b) {
+    rect2_t rect = { MIN(a.x, b.x), MIN(a.y, b.y), MAX(a.x, b.x), MAX(a.y, b.y) };
+
+    gs->selected_count = 0;
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t*   e   = &gs->entity_array[i];
+        f32         rad = entity_get_info(e)->rad;
+
+        e->selected = entity_is_unit(e) &&
+            e->pos.x + rad >= rect.min.x && e->pos.x - rad <= rect.max.x &&
+            e->pos.y + rad >= rect.min.y && e->pos.y - rad <= rect.max.y;
+
+        gs->selected_count += e->selected;
+    }
+}
+
 static void update_player(game_state_t* gs, f32 dt) {
     camera_t* cam = &gs->cam;
 
-    if (platform.keyboard.down[KEY_W]) { cam->pos.y += 8 * dt; }
-    if (platform.keyboard.down[KEY_S]) { cam->pos.y -= 8 * dt; }
-    if (platform.keyboard.down[KEY_A]) { cam->pos.x -= 8 * dt; }
-    if (platform.keyboard.down[KEY_D]) { cam->pos.x += 8 * dt; }
+    if (input.key_down[KEY_W]) { cam->pos.y += 8 * dt; }
+    if (input.key_down[KEY_S]) { cam->pos.y -= 8 * dt; }
+    if (input.key_down[KEY_A]) { cam->pos.x -= 8 * dt; }
+    if (input.key_down[KEY_D]) { cam->pos.x += 8 * dt; }
+
+    if (input.key_down[KEY_KP_ADD])         { cam->pos.z -= 8 * dt; }
+    if (input.key_down[KEY_KP_SUBTRACT])    { cam->pos.z += 8 * dt; }
+
+    // shift + drag selects units, right click sends them somewhere:
+    if (input.key_down[KEY_LEFT_SHIFT] && input.mouse_pressed[MOUSE_BUTTON_LEFT]) {
+        gs->selecting       = true;
+        gs->select_start    = input.mouse_position.xy;
+    }
 
-    if (platform.keyboard.down[KEY_KP_ADD])         { cam->pos.z -= 8 * dt; }
-    if (platform.keyboard.down[KEY_KP_SUBTRACT])    { cam->pos.z += 8 * dt; }
+    if (gs->selecting) {
+        gs->select_end = input.mouse_position.xy;
 
-    if (platform.mouse.down[MOUSE_BUTTON_LEFT]) {
-        tile_t* tile = NULL;
+        if (!input.mouse_down[MOUSE_BUTTON_LEFT]) {
+            select_units(gs, gs->select_start, gs->select_end);
+            gs->selecting = false;
+        }
+    } else if (input.mouse_down[MOUSE_BUTTON_LEFT]) {
+        i32 x = floorf(input.mouse_position.x);
+        i32 y = floorf(input.mouse_position.y);
 
-        if (tile = map_get_tile(&gs->map, floorf(mouse_position.x), floorf(mouse_position.y))) {
-            tile->order = gs->order_tool;
+        if (!OFF_MAP(x, y)) {
+            command_set_order(command_buffer_get(0), x, y, gs->order_tool);
         }
     }
-    
-    if (platform.mouse.down[MOUSE_BUTTON_RIGHT]) {
-        tile_t* tile = NULL;
 
-        if (tile = map_get_tile(&gs->map, floorf(mouse_position.x), floorf(mouse_position.y))) {
-            tile->order     = ORDER_TYPE_NONE;
-            tile->worker_id = 0;
+    if (gs->selected_count) {
+        if (input.mouse_pressed[MOUSE_BUTTON_RIGHT]) {
+            group_order_move(gs, command_buffer_get(0), input.mouse_position.xy);
+        }
+    } else if (input.mouse_down[MOUSE_BUTTON_RIGHT]) {
+        i32 x = floorf(input.mouse_position.x);
+        i32 y = floorf(input.mouse_position.y);
+
+        if (!OFF_MAP(x, y)) {
+            command_set_order(command_buffer_get(0), x, y, ORDER_TYPE_NONE);
         }
     }
 
-    if (platform.mouse.scroll.y < 0) {
+    if (input.scroll.y < 0) {
         gs->order_tool++;
     }
 
-    if (platform.mouse.scroll.y > 0) {
+    if (input.scroll.y > 0) {
         gs->order_tool--;
     }
 
     gs->order_tool = CLAMP(gs->order_tool, ORDER_TYPE_NONE + 1, ORDER_TYPE_COUNT - 1);
 }
 
-static void update_entity_physics(game_state_t* gs, f32 dt) {
+// the entities physics and collisions work on this tick, in entity order. Gathered once the ai is done reordering,
+// anything woken after that is added at the end:
+static u32 awake_entity_count;
+static u32 awake_entity_array[ENTITY_MAX];
+
+static void gather_awake_entities(game_state_t* gs) {
+    awake_entity_count = 0;
+
     for (u32 i = 0; i < gs->entity_count; ++i) {
-        entity_t* e = &gs->entity_array[i];
+        awake_entity_array[awake_entity_count] = i;
+        awake_entity_count += !gs->entity_array[i].asleep;
+    }
+}
+
+static void wake_entity(game_state_t* gs, u32 index) {
+    entity_t* e = &gs->entity_array[index];
+
+    if (e->asleep) {
+        entity_wake(e);
+        awake_entity_array[awake_entity_count++] = index;
+    }
+}
+
+static void update_entity_physics(game_state_t* gs, f32 dt) {
+    gather_awake_entities(gs);
+
+    for (u32 i = 0; i < awake_entity_count; ++i) {
+        entity_t* e = &gs->entity_array[awake_entity_array[i]];
 
         e->pos.x += e->vel.x * dt;
         e->pos.y += e->vel.y * dt;
@@ -50,7 +111,10 @@ static void update_entity_physics(game_state_t* gs, f32 dt) {
     }
 }
 
-static void find_work(entity_t* e, game_state_t* gs) {
+// claims the closest order nobody is on, or one it is closer to than whoever is, the claims are settled at the flush:
+static void find_work(entity_t* e, game_state_t* gs, command_buffer_t* commands) {
+    u32 index = (u32)(e - gs->entity_array);
+
     path_init(v2_cast(vec2i_t, e->pos));
 
     while (!path_empty()) {
@@ -63,33 +127,20 @@ static void find_work(entity_t* e, game_state_t* gs) {
 
             if (tile) {
                 if (tile->order) {
-                    if (!tile->worker_id) {
-                        tile->worker_id = e->id;
-
-                        e->ai           = AI_WORKER_EXECUTE_ORDER;
-                        e->target_pos   = v2(next.x + 0.5, next.y + 0.5);
+                    f32 dist = v2_dist(e->pos, v2(next.x + 0.5, next.y + 0.5));
 
+                    if (!tile->worker_id) {
+                        command_claim_tile(commands, index, next.x, next.y, dist);
                         return;
                     } if (worker = get_entity(gs, tile->worker_id)) {
                         // transfrer order to entity 'e', if 'e' is closer:
-                        if (e != worker && v2_dist(e->pos, v2(next.x + 0.5, next.y + 0.5)) < v2_dist(worker->pos, v2(next.x + 0.5, next.y + 0.5))) {
-                            worker->ai          = AI_WORKER_IDLE;
-                            worker->target_pos  = worker->pos; 
-
-                            tile->worker_id     = e->id;
-
-                            e->ai               = AI_WORKER_EXECUTE_ORDER;
-                            e->target_pos       = v2(next.x + 0.5, next.y + 0.5);
-
+                        if (e != worker && dist < v2_dist(worker->pos, v2(next.x + 0.5, next.y + 0.5))) {
+                            command_claim_tile(commands, index, next.x, next.y, dist);
                             return;
                         }
                     } else {
                         // current worker has disappeared, transfrer order to entity 'e':
-                        tile->worker_id = e->id;
-
-                        e->ai           = AI_WORKER_EXECUTE_ORDER;
-                        e->target_pos   = v2(next.x + 0.5, next.y + 0.5);
-
+                        command_claim_tile(commands, index, next.x, next.y, dist);
                         return;
                     }
                 }
@@ -100,13 +151,25 @@ static void find_work(entity_t* e, game_state_t* gs) {
     }
 }
 
-static entity_t* find_closest_bug(game_state_t* gs, vec2_t pos) {
-    entity_t* result = NULL;
+// ants that a guard could go after, gathered once per tick for all idle guards:
+static u32 visible_ant_count;
+static u32 visible_ant_array[ENTITY_MAX];
 
-    for (u32 i = 0; i < gs->entity_count; ++i) {
+static void find_visible_ants(game_state_t* gs) {
+    visible_ant_count = 0;
+
+    for (u32 i = gs->ai_bucket[AI_ANT_IDLE]; i < gs->ai_bucket[AI_ANT_AGRO + 1]; ++i) {
         entity_t* e = &gs->entity_array[i];
 
-        if (e->type != ENTITY_TYPE_ANT) { continue; }
+        if (vis_is_visible(e->pos.x, e->pos.y)) {
+            visible_ant_array[visible_ant_count++] = i;
+        }
+    }
+}
+
+static entity_t* find_closest_bug(game_state_t* gs, vec2_t pos) {
+    for (u32 i = 0; i < visible_ant_count; ++i) {
+        entity_t* e = &gs->entity_array[visible_ant_array[i]];
 
         if (path_is_reachable(v2i(e->pos.x, e->pos.y), v2i(pos.x, pos.y), &gs->map)) {
             return e;
@@ -116,70 +179,271 @@ static entity_t* find_closest_bug(game_state_t* gs, vec2_t pos) {
     return NULL;
 }
 
-static void update_entity_ai(game_state_t* gs, f32 dt) {
-    for (u32 i = 0; i < gs->entity_count; ++i) {
-        entity_t* e = &gs->entity_array[i];
+static void entity_accelerate(entity_t* e, vec2_t dir, f32 dt) {
+    if (dir.x != 0 || dir.y != 0) {
+        entity_wake(e);
+    }
 
-        switch (e->ai) {
-            // Worker AI:
-            case AI_WORKER_IDLE: {
-                find_work(e, gs);
-            } break;
-            case AI_WORKER_EXECUTE_ORDER: {
-                tile_t* tile = NULL;
-                if (tile = map_get_tile(&gs->map, e->target_pos.x, e->target_pos.y)) {
-                    if (tile->order) {
-                        if (v2_dist_sq(e->pos, e->target_pos) <= (0.6 + entity_info_table[e->type].rad)) {
-                            switch (tile->order) {
-                                case ORDER_TYPE_DESTROY_TILE: {
-                                    destroy_tile(tile);
-                                } break;
-                                case ORDER_TYPE_BUILD_ROCK_WALL: {
-                                    init_tile(tile, TILE_TYPE_ROCK_WALL);
-                                } break;
-                            }
-
-                            e->target_pos   = e->pos;
-                            e->ai           = AI_WORKER_IDLE;
-                            tile->worker_id = 0;
-                        }
-                    } else {
-                        e->target_pos   = e->pos;
-                        e->ai           = AI_WORKER_IDLE;
-                        tile->worker_id = 0;
-                    }
-                }
-            } break;
-            // Guard AI:
-            case AI_GUARD_IDLE: {
-                entity_t* target = NULL;
-                if (target = find_closest_bug(gs, e->pos)) {
-                    e->ai           = AI_GUARD_KILL_TARGET;
-                    e->target_id    = target->id;
-                }
-            } break;
-            case AI_GUARD_KILL_TARGET: {
-                entity_t* target = NULL;
-                if (target = get_entity(gs, e->target_id)) {
-                    e->target_pos   = target->pos;
-
-                    if (v2_dist(e->pos, target->pos) < (0.05 + entity_get_info(e)->rad + entity_get_info(target)->rad)) {
-                        target->life = 0;
+    e->vel.x += 6 * dir.x * dt;
+    e->vel.y += 6 * dir.y * dt;
+}
+
+// the handle is handed out before the systems run, see 'prepare_entity_ai':
+static void entity_steer(game_state_t* gs, entity_t* e, f32 dt) {
+    entity_accelerate(e, path_service_steer(e->path_handle, &gs->map, e->pos, e->target_pos), dt);
+}
+
+// pushes away from the entities close by, as they were at the end of the last tick (see 'entity_grid'):
+static vec2_t entity_separation(game_state_t* gs, const entity_t* e) {
+    vec2_t  push    = v2(0);
+
+    rect2i_t near_rect = {
+        CLAMP((i32)e->pos.x - 1, 0, MAP_SIZE - 1),
+        CLAMP((i32)e->pos.y - 1, 0, MAP_SIZE - 1),
+        CLAMP((i32)e->pos.x + 1, 0, MAP_SIZE - 1),
+        CLAMP((i32)e->pos.y + 1, 0, MAP_SIZE - 1),
+    };
+
+    for_rect2(near_rect, x, y) {
+        for_entity_grid_entry(&entity_grid, x, y, other) {
+            if (other->id == e->id) continue;
+
+            vec2_t  delta   = v2_sub(e->pos, other->pos);
+            f32     range   = entity_get_info(e)->rad + other->rad + 0.1f;
+            f32     dist    = v2_len(delta);
+
+            if (dist < range && dist > 0.0001f) {
+                push = v2_add(push, v2_scale(delta, (range - dist) / (range * dist)));
+            }
+        }
+    }
+
+    return push;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------
+// ai systems, each one runs over the entities in a single state:
+
+// anything a system does besides changing its own entities goes into 'commands':
+typedef void ai_system_t(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt);
+
+#define for_ai_bucket(e, begin, end) \
+    for (entity_t* e = (begin); e != (end); ++e) \
+        if (e->next_ai == e->ai)
+
+static void ai_worker_idle(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    for_ai_bucket(e, begin, end) {
+        find_work(e, gs, commands);
+    }
+}
+
+static void ai_worker_execute_order(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    for_ai_bucket(e, begin, end) {
+        u32     index   = (u32)(e - gs->entity_array);
+        i32     x       = e->target_pos.x;
+        i32     y       = e->target_pos.y;
+        tile_t* tile    = NULL;
+
+        if (tile = map_get_tile(&gs->map, x, y)) {
+            if (tile->order) {
+                if (v2_dist_sq(e->pos, e->target_pos) <= (0.6 + entity_info_table[e->type].rad)) {
+                    switch (tile->order) {
+                        case ORDER_TYPE_DESTROY_TILE: {
+                            command_destroy_tile(commands, index, x, y);
+                        } break;
+                        case ORDER_TYPE_BUILD_ROCK_WALL: {
+                            command_set_tile(commands, index, x, y, TILE_TYPE_ROCK_WALL);
+                        } break;
                     }
-                } else {
-                    e->ai           = AI_GUARD_IDLE;
-                    e->target_id    = 0;
+
+                    e->target_pos = e->pos;
+                    command_release_tile(commands, index, x, y);
+                    entity_set_ai(e, AI_WORKER_IDLE);
                 }
-            } break;
+            } else {
+                e->target_pos = e->pos;
+                command_release_tile(commands, index, x, y);
+                entity_set_ai(e, AI_WORKER_IDLE);
+            }
         }
 
-        vec2_t dir = path_get_direction_towards(e->pos, v2_cast(vec2_t, e->target_pos), &gs->map);
+        entity_steer(gs, e, dt);
+    }
+}
+
+static void ai_guard_idle(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    if (visible_ant_count == 0) return;
+
+    for_ai_bucket(e, begin, end) {
+        entity_t* target = NULL;
+        if (target = find_closest_bug(gs, e->pos)) {
+            e->target_id = target->id;
+            entity_set_ai(e, AI_GUARD_KILL_TARGET);
+        }
+    }
+}
+
+static void ai_guard_kill_target(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    for_ai_bucket(e, begin, end) {
+        entity_t* target = NULL;
+        if (target = get_entity(gs, e->target_id)) {
+            e->target_pos   = target->pos;
+
+            if (v2_dist(e->pos, target->pos) < (0.05 + entity_get_info(e)->rad + entity_get_info(target)->rad)) {
+                command_despawn(commands, (u32)(e - gs->entity_array), (u32)(target - gs->entity_array));
+            }
+        } else {
+            e->target_id    = 0;
+            entity_set_ai(e, AI_GUARD_IDLE);
+        }
 
-        e->vel.x += 6 * dir.x * dt;
-        e->vel.y += 6 * dir.y * dt;
+        entity_steer(gs, e, dt);
     }
 }
 
+// the field is read from the last step, so which ant goes first doesn't matter:
+static void ai_ant_idle(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    for_ai_bucket(e, begin, end) {
+        if (pheromone_get(PHEROMONE_ALARM, e->pos.x, e->pos.y) >= PHEROMONE_ALERT) {
+            entity_set_ai(e, AI_ANT_FOLLOW);
+        }
+    }
+}
+
+static void ai_ant_follow(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    for_ai_bucket(e, begin, end) {
+        if (pheromone_get(PHEROMONE_ALARM, e->pos.x, e->pos.y) < PHEROMONE_CALM) {
+            e->target_pos = e->pos;
+            entity_set_ai(e, AI_ANT_IDLE);
+            continue;
+        }
+
+        vec2_t  dir = pheromone_gradient(PHEROMONE_ALARM, e->pos);
+        f32     len = v2_len(dir);
+
+        // on top of it, or the trail is flat here:
+        if (len > 0.0001f) {
+            entity_accelerate(e, v2_scale(dir, 1.0f / len), dt);
+        }
+    }
+}
+
+// agro ants each head for a spot of their own, which a field shared by every ant can't point them at, so they keep
+// using the path service (whose searches are cached, and shared between ants going the same way):
+static void ai_ant_agro(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    for_ai_bucket(e, begin, end) {
+        entity_steer(gs, e, dt);
+    }
+}
+
+static void ai_unit_move(game_state_t* gs, entity_t* begin, entity_t* end, command_buffer_t* commands, f32 dt) {
+    // nothing to see through, not even the target tile:
+    const vec2i_t no_goal = { -1, -1 };
+
+    for_ai_bucket(e, begin, end) {
+        group_t* group = group_get(e->group_handle);
+
+        // left the group before the systems ran:
+        if (!group) continue;
+
+        // a slot on the far side of a wall is no good, wait at the leader point instead:
+        vec2_t slot = group_slot_pos(group, e->group_slot);
+
+        if (!path_line_of_sight(group->pos, slot, &gs->map, NULL, no_goal)) {
+            slot = group->pos;
+        }
+
+        e->target_pos = slot;
+
+        group->next_leader_dist = MAX(group->next_leader_dist, v2_dist(e->pos, group->pos));
+        group->next_slot_dist   = MAX(group->next_slot_dist, v2_dist(e->pos, slot));
+
+        vec2_t goal = slot;
+
+        // a trail point it is already standing on leads nowhere (say in a doorway with the rest of the trail around the
+        // corner), so that one goes to the path service too:
+        if (path_line_of_sight(e->pos, goal, &gs->map, NULL, no_goal) ||
+            (group_find_trail(group, &gs->map, e->pos, &goal) && v2_dist(e->pos, goal) > PATH_ARRIVE_RADIUS)) {
+            vec2_t  delta   = v2_sub(goal, e->pos);
+            f32     dist    = v2_len(delta);
+
+            // slows down over the last tile:
+            if (dist > PATH_ARRIVE_RADIUS) {
+                entity_accelerate(e, v2_scale(delta, MIN(dist, 1) / dist), dt);
+            }
+        } else {
+            entity_steer(gs, e, dt);
+        }
+
+        entity_accelerate(e, entity_separation(gs, e), dt);
+    }
+}
+
+// anything without a system is never looked at:
+static ai_system_t* ai_system_table[AI_Count] = {
+    [AI_WORKER_IDLE]            = ai_worker_idle,
+    [AI_WORKER_EXECUTE_ORDER]   = ai_worker_execute_order,
+    [AI_GUARD_IDLE]             = ai_guard_idle,
+    [AI_GUARD_KILL_TARGET]      = ai_guard_kill_target,
+    [AI_ANT_IDLE]               = ai_ant_idle,
+    [AI_ANT_FOLLOW]             = ai_ant_follow,
+    [AI_ANT_AGRO]               = ai_ant_agro,
+    [AI_UNIT_MOVE]              = ai_unit_move,
+};
+
+// everything the systems share is brought up to date here, before any of them runs, so they only read it:
+static void prepare_entity_ai(game_state_t* gs, f32 dt) {
+    static const ai_type_t steering[] = { AI_WORKER_EXECUTE_ORDER, AI_GUARD_KILL_TARGET, AI_ANT_AGRO, AI_UNIT_MOVE };
+
+    for (u32 i = 0; i < ARRAY_COUNT(steering); ++i) {
+        for (u32 j = gs->ai_bucket[steering[i]]; j < gs->ai_bucket[steering[i] + 1]; ++j) {
+            entity_t* e = &gs->entity_array[j];
+            if (!e->path_handle) e->path_handle = path_service_acquire();
+        }
+    }
+
+    if (gs->ai_bucket[AI_GUARD_IDLE] != gs->ai_bucket[AI_GUARD_IDLE + 1]) {
+        find_visible_ants(gs);
+    }
+
+    if (gs->ai_bucket[AI_UNIT_MOVE] == gs->ai_bucket[AI_UNIT_MOVE + 1]) return;
+
+    update_groups(gs, dt);
+
+    for (u32 i = gs->ai_bucket[AI_UNIT_MOVE]; i < gs->ai_bucket[AI_UNIT_MOVE + 1]; ++i) {
+        entity_t*   e       = &gs->entity_array[i];
+        group_t*    group   = group_get(e->group_handle);
+
+        if (e->next_ai != e->ai || (group && !group->done)) continue;
+
+        group_leave(e);
+
+        e->target_pos = e->pos;
+        entity_set_ai(e, entity_get_info(e)->ai);
+    }
+}
+
+static void update_entity_ai(game_state_t* gs, f32 dt) {
+    command_buffer_t* commands = command_buffer_get(0);
+
+    path_service_collect(&gs->map);
+    sort_entity_buckets(gs);
+    prepare_entity_ai(gs, dt);
+
+    for (u32 ai = 0; ai < AI_Count; ++ai) {
+        u32 begin   = gs->ai_bucket[ai];
+        u32 end     = gs->ai_bucket[ai + 1];
+
+        if (ai_system_table[ai] && begin != end) {
+            ai_system_table[ai](gs, &gs->entity_array[begin], &gs->entity_array[end], commands, dt);
+        }
+    }
+
+    command_flush(gs);
+    sort_entity_buckets(gs);
+    path_service_submit(&gs->map);
+}
+
 static c2Circle get_entity_circle(const entity_t* e) {
     return (c2Circle) {
         .p = { e->pos.x, e->pos.y },
@@ -187,23 +451,68 @@ static c2Circle get_entity_circle(const entity_t* e) {
     };
 }
 
+static void wake_entities_near_changed_tiles(game_state_t* gs) {
+    map_t* map = &gs->map;
+
+    if (map->change_overflow) {
+        for (u32 i = 0; i < gs->entity_count; ++i) {
+            wake_entity(gs, i);
+        }
+
+        return;
+    }
+
+    for (u32 i = 0; i < map->change_count; ++i) {
+        vec2i_t     pos     = map->change_array[i];
+        rect2i_t    rect    = { pos.x - 1, pos.y - 1, pos.x + 1, pos.y + 1 };
+
+        for_rect2(rect, x, y) {
+            if (OFF_MAP(x, y)) continue;
+
+            for_entity_grid(&entity_grid, x, y, j) {
+                wake_entity(gs, j);
+            }
+        }
+    }
+}
+
+// the one 'entity_grid' build of the tick, the ai of the next tick steers around what is left in it:
 static void handle_entity_collisions(game_state_t* gs, f32 dt) {
-    // @TODO: broad-phase this shit!
+    entity_grid_build(&entity_grid, gs);
+    wake_entities_near_changed_tiles(gs);
+
     c2Manifold m;
-    for (u32 i = 0; i < gs->entity_count; ++i) {
+    for (u32 w = 0; w < awake_entity_count; ++w) {
+        u32       i          = awake_entity_array[w];
         entity_t* a          = &gs->entity_array[i];
         c2Circle  a_circle   = get_entity_circle(a);
+        f32       depth      = 0;
+
+        rect2i_t near_rect = {
+            CLAMP((i32)a->pos.x - 1, 0, MAP_SIZE - 1),
+            CLAMP((i32)a->pos.y - 1, 0, MAP_SIZE - 1),
+            CLAMP((i32)a->pos.x + 1, 0, MAP_SIZE - 1),
+            CLAMP((i32)a->pos.y + 1, 0, MAP_SIZE - 1),
+        };
 
-        for (u32 j = 0; j < gs->entity_count; ++j) {
-            if (i == j) continue;
-            const entity_t* b = &gs->entity_array[j];
+        for_rect2(near_rect, x, y) {
+            for_entity_grid(&entity_grid, x, y, j) {
+                if (i == j) continue;
+                entity_t* b = &gs->entity_array[j];
+
+                c2CircletoCircleManifold(a_circle, get_entity_circle(b), &m);
+                for (int k = 0; k < m.count; ++k) {
+                    a->pos.x -= m.depths[k] * m.n.x;
+                    a->pos.y -= m.depths[k] * m.n.y;
+                    a->vel.x -= m.depths[k] * m.n.x * dt;
+                    a->vel.y -= m.depths[k] * m.n.y * dt;
+
+                    depth = MAX(depth, m.depths[k]);
+                }
 
-            c2CircletoCircleManifold(a_circle, get_entity_circle(b), &m);
-            for (int k = 0; k < m.count; ++k) {
-                a->pos.x -= m.depths[k] * m.n.x;
-                a->pos.y -= m.depths[k] * m.n.y;
-                a->vel.x -= m.depths[k] * m.n.x * dt;
-                a->vel.y -= m.depths[k] * m.n.y * dt;
+                if (m.count) {
+                    wake_entity(gs, j);
+                }
             }
         }
 
@@ -224,32 +533,47 @@ static void handle_entity_collisions(game_state_t* gs, f32 dt) {
                     a->pos.y -= m.depths[k] * m.n.y;
                     a->vel.x -= m.depths[k] * m.n.x * dt;
                     a->vel.y -= m.depths[k] * m.n.y * dt;
+
+                    depth = MAX(depth, m.depths[k]);
                 }
             }
         }
+
+        if (v2_len_sq(a->vel) < ENTITY_SLEEP_VELOCITY * ENTITY_SLEEP_VELOCITY && depth < ENTITY_SLEEP_DEPTH) {
+            a->rest_time += dt;
+        } else {
+            a->rest_time = 0;
+        }
     }
-}
 
-static void handle_dead_entities(game_state_t* gs, f32 dt) {
-    for (u32 i = 0; i < gs->entity_count; ++i) {
-        entity_t* e = &gs->entity_array[i];
+    // only after everyone moved, so an entity can't fall asleep and be woken into the list a second time:
+    for (u32 w = 0; w < awake_entity_count; ++w) {
+        entity_t* e = &gs->entity_array[awake_entity_array[w]];
 
-        if (e->life <= 0) {
-            gs->entity_array[i] = gs->entity_array[--gs->entity_count];
+        if (e->rest_time >= ENTITY_SLEEP_TIME) {
+            e->asleep   = true;
+            e->vel      = v2(0);
         }
     }
+
+    entity_grid_refresh(&entity_grid, gs, awake_entity_array, awake_entity_count);
 }
 
 static void update_entities(game_state_t* gs, f32 dt) {
-    update_entity_ai(gs, dt);
-    update_entity_physics(gs, dt);
-    handle_entity_collisions(gs, dt);
-    handle_dead_entities(gs, dt);
+    profile_block(PROFILE_AI)           update_entity_ai(gs, dt);
+    profile_block(PROFILE_PHYSICS)      update_entity_physics(gs, dt);
+    profile_block(PROFILE_COLLISIONS)   handle_entity_collisions(gs, dt);
+    profile_block(PROFILE_VISIBILITY)   update_visibility(gs);
+    profile_block(PROFILE_LIGHT)        update_light(gs);
+    profile_block(PROFILE_PHEROMONE)    update_pheromones(gs, dt);
 }
 
 static void update_map(game_state_t* gs, f32 dt) {
-    for_map(x, y) {
-        tile_t* tile = &gs->map.tiles[y][x];
+    map_clear_changes(&gs->map);
+
+    // no coordinates needed, so walk the tiles straight through memory:
+    for (u32 i = 0; i < MAP_SIZE * MAP_SIZE; ++i) {
+        tile_t* tile = &gs->map.tiles[i];
 
         if (tile_get_info(tile)->is_wall == order_info_table[tile->type].on_ground) {
             tile->order = ORDER_TYPE_NONE;
@@ -279,8 +603,12 @@ static void update_particles(game_state_t* gs, f32 dt) {
 
 static void update_game(game_state_t* gs, f32 dt) {
     update_player(gs, dt);
-    update_map(gs, dt);
+
+    profile_block(PROFILE_MAP)          update_map(gs, dt);
+    profile_block(PROFILE_COLONY)       update_colony(gs, dt);
     update_entities(gs, dt);
-    update_particles(gs, dt);
+    profile_block(PROFILE_PARTICLES)    update_particles(gs, dt);
+    profile_block(PROFILE_MINIMAP)      update_minimap(gs);
+    profile_block(PROFILE_SAVE)         update_autosave(gs, dt);
 }
 
@@ -0,0 +1,234 @@
+
+// Fog of war.
+//
+// Workers and guards are viewers. Each viewer remembers the tiles it saw the last time it looked (recursive
+// shadowcasting over the walls), and every tile keeps a count of how many viewers currently see it. A viewer only looks
+// again when it crosses into another tile or when a tile within its radius changes, at which point its old tiles are
+// released and the new ones added, so the cost follows what changed instead of viewers * radius^2 every tick.
+
+#define VIS_RADIUS      (8)
+#define VIS_TILE_MAX    ((2 * VIS_RADIUS + 1) * (2 * VIS_RADIUS + 1))
+#define VIS_VIEWER_MAX  (ENTITY_MAX)
+
+#define VIS_EXPLORED_CHANGE_MAX (1024)
+
+typedef struct vis_viewer_t {
+    b32         in_use;
+    b32         dirty;
+    vec2i_t     tile;
+
+    u32         tile_count;
+    u32         tile_array[VIS_TILE_MAX];
+} vis_viewer_t;
+
+static u16          vis_count[MAP_SIZE][MAP_SIZE];
+static u8           vis_explored[MAP_SIZE][MAP_SIZE];
+
+static u32          vis_stamp_id;
+static u32          vis_stamp[MAP_SIZE][MAP_SIZE];
+
+// tiles explored for the first time this tick, if it overflows everything should be treated as changed:
+static b32          vis_explored_overflow;
+static u32          vis_explored_count;
+static vec2i_t      vis_explored_array[VIS_EXPLORED_CHANGE_MAX];
+
+static vis_viewer_t vis_viewer_array[VIS_VIEWER_MAX];
+static u32          vis_free_count;
+static u32          vis_free_array[VIS_VIEWER_MAX];
+
+static void vis_init(void) {
+    memset(vis_count,           0, sizeof (vis_count));
+    memset(vis_explored,        0, sizeof (vis_explored));
+    memset(vis_viewer_array,    0, sizeof (vis_viewer_array));
+
+    vis_free_count = 0;
+
+    for (u32 i = VIS_VIEWER_MAX; i > 0; --i) {
+        vis_free_array[vis_free_count++] = i;
+    }
+}
+
+static b32 vis_is_visible(i32 x, i32 y) {
+    return !OFF_MAP(x, y) && vis_count[y][x] > 0;
+}
+
+static b32 vis_is_explored(i32 x, i32 y) {
+    return !OFF_MAP(x, y) && vis_explored[y][x];
+}
+
+static b32 entity_is_viewer(const entity_t* e) {
+    return e->type == ENTITY_TYPE_WORKER || e->type == ENTITY_TYPE_GUARD;
+}
+
+static vis_viewer_t* vis_get_viewer(u32 handle) {
+    if (handle == 0 || handle > VIS_VIEWER_MAX) return NULL;
+    return &vis_viewer_array[handle - 1];
+}
+
+static void vis_clear_viewer(vis_viewer_t* viewer) {
+    for (u32 i = 0; i < viewer->tile_count; ++i) {
+        u32 index = viewer->tile_array[i];
+        vis_count[index / MAP_SIZE][index % MAP_SIZE]--;
+    }
+
+    viewer->tile_count = 0;
+}
+
+static u32 vis_acquire(void) {
+    if (vis_free_count == 0) return 0;
+
+    u32             handle = vis_free_array[--vis_free_count];
+    vis_viewer_t*   viewer = vis_get_viewer(handle);
+
+    viewer->in_use      = true;
+    viewer->dirty       = true;
+    viewer->tile_count  = 0;
+
+    return handle;
+}
+
+static void vis_release(u32 handle) {
+    vis_viewer_t* viewer = vis_get_viewer(handle);
+    if (!viewer || !viewer->in_use) return;
+
+    vis_clear_viewer(viewer);
+    viewer->in_use = false;
+
+    vis_free_array[vis_free_count++] = handle;
+}
+
+static void vis_mark(vis_viewer_t* viewer, i32 x, i32 y) {
+    if (vis_stamp[y][x] == vis_stamp_id) return;
+
+    if (!vis_explored[y][x]) {
+        if (vis_explored_count < VIS_EXPLORED_CHANGE_MAX) {
+            vis_explored_array[vis_explored_count++] = v2i(x, y);
+        } else {
+            vis_explored_overflow = true;
+        }
+    }
+
+    vis_stamp[y][x]     = vis_stamp_id;
+    vis_explored[y][x]  = true;
+    vis_count[y][x]++;
+
+    viewer->tile_array[viewer->tile_count++] = y * MAP_SIZE + x;
+}
+
+// one octant of recursive shadowcasting, (xx, xy, yx, yy) maps the octant onto the grid:
+static void vis_cast(vis_viewer_t* viewer, const map_t* map, i32 row, f32 start, f32 end, i32 xx, i32 xy, i32 yx, i32 yy) {
+    if (start < end) return;
+
+    i32 cx          = viewer->tile.x;
+    i32 cy          = viewer->tile.y;
+    f32 new_start   = 0;
+
+    for (i32 j = row; j <= VIS_RADIUS; ++j) {
+        b32 blocked = false;
+        i32 dy      = -j;
+
+        for (i32 dx = -j; dx <= 0; ++dx) {
+            i32 x = cx + dx * xx + dy * xy;
+            i32 y = cy + dx * yx + dy * yy;
+
+            f32 left_slope  = (dx - 0.5f) / (dy + 0.5f);
+            f32 right_slope = (dx + 0.5f) / (dy - 0.5f);
+
+            if (start < right_slope) continue;
+            if (end > left_slope) break;
+
+            b32 is_wall = !map_is_traversable(map, x, y);
+
+            if (!OFF_MAP(x, y) && dx * dx + dy * dy <= VIS_RADIUS * VIS_RADIUS) {
+                vis_mark(viewer, x, y);
+            }
+
+            if (blocked) {
+                if (is_wall) {
+                    new_start = right_slope;
+                } else {
+                    blocked = false;
+                    start   = new_start;
+                }
+            } else if (is_wall && j < VIS_RADIUS) {
+                blocked = true;
+                vis_cast(viewer, map, j + 1, start, left_slope, xx, xy, yx, yy);
+                new_start = right_slope;
+            }
+        }
+
+        if (blocked) break;
+    }
+}
+
+static void vis_look(vis_viewer_t* viewer, const map_t* map, vec2i_t tile) {
+    static const i32 octants[8][4] = {
+        {  1,  0,  0,  1 }, {  0,  1,  1,  0 }, {  0, -1,  1,  0 }, { -1,  0,  0,  1 },
+        { -1,  0,  0, -1 }, {  0, -1, -1,  0 }, {  0,  1, -1,  0 }, {  1,  0,  0, -1 },
+    };
+
+    vis_clear_viewer(viewer);
+
+    viewer->tile    = tile;
+    viewer->dirty   = false;
+
+    if (OFF_MAP(tile.x, tile.y)) return;
+
+    vis_stamp_id++;
+    vis_mark(viewer, tile.x, tile.y);
+
+    for (u32 i = 0; i < ARRAY_COUNT(octants); ++i) {
+        vis_cast(viewer, map, 1, 1.0f, 0.0f, octants[i][0], octants[i][1], octants[i][2], octants[i][3]);
+    }
+}
+
+// flags every viewer that has a changed tile within its radius:
+static void vis_mark_changes(const map_t* map) {
+    for (u32 i = 0; i < VIS_VIEWER_MAX; ++i) {
+        vis_viewer_t* viewer = &vis_viewer_array[i];
+
+        if (!viewer->in_use || viewer->dirty) continue;
+
+        if (map->change_overflow) {
+            viewer->dirty = true;
+            continue;
+        }
+
+        for (u32 j = 0; j < map->change_count; ++j) {
+            vec2i_t change = map->change_array[j];
+
+            if (abs(change.x - viewer->tile.x) <= VIS_RADIUS && abs(change.y - viewer->tile.y) <= VIS_RADIUS) {
+                viewer->dirty = true;
+                break;
+            }
+        }
+    }
+}
+
+static void update_visibility(game_state_t* gs) {
+    vis_explored_overflow   = false;
+    vis_explored_count      = 0;
+
+    if (gs->map.change_overflow || gs->map.change_count) {
+        vis_mark_changes(&gs->map);
+    }
+
+    for (u32 i = 0; i < gs->entity_count; ++i) {
+        entity_t* e = &gs->entity_array[i];
+
+        if (!entity_is_viewer(e)) continue;
+
+        if (!e->vis_handle) {
+            e->vis_handle = vis_acquire();
+        }
+
+        vis_viewer_t* viewer = vis_get_viewer(e->vis_handle);
+        if (!viewer) continue;
+
+        vec2i_t tile = v2_cast(vec2i_t, e->pos);
+
+        if (viewer->dirty || tile.x != viewer->tile.x || tile.y != viewer->tile.y) {
+            vis_look(viewer, &gs->map, tile);
+        }
+    }
+}